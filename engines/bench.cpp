@@ -0,0 +1,30 @@
+#include <iostream>
+
+#include "bench.hpp"
+#include "log.hpp"
+#include "preCalculation.hpp"
+
+int main(int argc, char **argv) {
+    // bench.out [searchDepth] [perftDepth] [hashMB] [threads]
+    logging::setLogLevel(logging::logLevel::error);
+    preCalculation::preCalcType preCalcData = preCalculation::load();
+    uint8_t searchDepth = argc > 1 ? std::stoi(argv[1]) : 5;
+    uint8_t perftDepth = argc > 2 ? std::stoi(argv[2]) : 4;
+    unsigned int hashMB = argc > 3 ? std::stoi(argv[3]) : 0;
+    unsigned int threads = argc > 4 ? std::stoi(argv[4]) : 1;
+    std::cout << "Sliding attacks: " << bench::getSliderBackend() << std::endl;
+    std::cout << "PreCalc load time(us): " << preCalculation::loadTimeUs << std::endl;
+    bench::printResult("Perft", bench::perftNodes(preCalcData, perftDepth));
+    bench::printResult("Search", bench::searchNodes(preCalcData, searchDepth));
+    if (hashMB > 0) {
+        bench::BenchResult result = bench::searchNodes(preCalcData, searchDepth, hashMB);
+        bench::printResult("Search with TT", result);
+        bench::printTTResult(result, hashMB);
+        if (threads > 1) {
+            bench::BenchResult threadedResult = bench::searchNodes(preCalcData, searchDepth, hashMB, threads);
+            bench::printResult("Search with TT and threads", threadedResult);
+            bench::printSpeedup(result, threadedResult, threads);
+        }
+    }
+    return 0;
+}
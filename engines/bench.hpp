@@ -0,0 +1,121 @@
+#ifndef CHESS_BENCH_H
+#define CHESS_BENCH_H 1
+
+#include <iostream>
+#include <chrono>
+#include <string>
+
+#include "board.cpp"
+#include "chessBot.hpp"
+#include "perft.hpp"
+#include "preCalculation.hpp"
+#include "statsutil.hpp"
+#include "transpositionTables.hpp"
+#include "utils.hpp"
+
+using std::string;
+
+namespace bench {
+    struct BenchResult {
+        unsigned long long nodes;
+        long long elapsedMs;
+        unsigned long long ttInserts = 0;
+        unsigned long long ttCollisions = 0;
+        unsigned long long ttMisses = 0;
+        unsigned long long ttExactHits = 0;
+        unsigned long long cutoffs = 0;
+        unsigned long long firstMoveCutoffs = 0;
+        unsigned long long aspirationFailLows = 0;
+        unsigned long long aspirationFailHighs = 0;
+
+        unsigned long long nodesPerSecond() {
+            return nodes * 1000 / std::max(elapsedMs, 1LL);
+        }
+    };
+
+    // Middlegame heavy, so sliders dominate the attack lookups
+    const string benchPositions[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    };
+
+    string getSliderBackend() {
+#ifdef USE_PEXT
+        return "pext";
+#else
+        return "magic";
+#endif
+    }
+
+    BenchResult perftNodes(preCalculation::preCalcType &preCalcData, uint8_t depth) {
+        BenchResult total = {0, 0};
+        for (const string &fen: benchPositions) {
+            Board boardInstance(fen, preCalcData->PRN);
+            perft::PerftResult result = perft::run(boardInstance, preCalcData, depth);
+            total.nodes += result.nodes;
+            total.elapsedMs += result.elapsedMs;
+        }
+        return total;
+    }
+
+    BenchResult searchNodes(preCalculation::preCalcType &preCalcData, uint8_t depth, unsigned int hashMB = 0, unsigned int threads = 1) {
+        // Fixed depth, no time limit, so every build searches the same tree. TT only if hashMB is set,
+        // more than one thread needs the TT and isn't deterministic
+        BenchResult total = {0, 0};
+        for (const string &fen: benchPositions) {
+            ChessBot bot(randomUtils::getHashFileName(), preCalcData);
+            bot.setEnableAlphaBetaPruning(true);
+            bot.setEnableQuiescenceSearch(true);
+            bot.setMaxDepth(depth);
+            if (hashMB > 0) {
+                bot.setHashSize(hashMB);
+                bot.setEnableTT(true);
+                bot.setEnableIterativeDeepening(true);
+                bot.setThreads(threads);
+            }
+            Board boardInstance(fen, preCalcData->PRN);
+            auto start = std::chrono::steady_clock::now();
+            bot.getNextMove(boardInstance);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            total.nodes += stats::counters.nodeCount;
+            total.ttInserts += stats::counters.ttInserts;
+            total.ttCollisions += stats::counters.ttCollisions;
+            total.ttMisses += stats::counters.ttMisses;
+            total.ttExactHits += stats::counters.ttExactHits;
+            total.cutoffs += stats::counters.cutoffCount;
+            total.firstMoveCutoffs += stats::counters.firstMoveCutoffCount;
+            total.aspirationFailLows += stats::counters.aspirationFailLows;
+            total.aspirationFailHighs += stats::counters.aspirationFailHighs;
+            total.elapsedMs += std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+        }
+        return total;
+    }
+
+    void printResult(const string &name, BenchResult result) {
+        std::cout << name << ": nodes " << result.nodes << " time(ms) " << result.elapsedMs
+            << " nps " << result.nodesPerSecond() << std::endl;
+    }
+
+    void printSpeedup(BenchResult single, BenchResult result, unsigned int threads) {
+        // Time to the same depth, the node counts differ between runs
+        std::cout << "Threads: " << threads << " speedup " << (double) single.elapsedMs / std::max(result.elapsedMs, 1LL)
+            << " nps speedup " << (double) result.nodesPerSecond() / std::max(single.nodesPerSecond(), 1ULL) << std::endl;
+    }
+
+    void printTTResult(BenchResult result, unsigned int hashMB) {
+        unsigned long entriesPerBucket = std::tuple_size<decltype(HashBucket::entries)>::value;
+        std::cout << "TT: entry size " << sizeof(HashEntry) << " entries/bucket " << entriesPerBucket
+            << " entries/MB " << 1024 * 1024 / sizeof(HashBucket) * entriesPerBucket
+            << " hash(MB) " << hashMB << " inserts " << result.ttInserts << " collisions " << result.ttCollisions
+            << " misses " << result.ttMisses << " exact hits " << result.ttExactHits << std::endl;
+        std::cout << "Beta cutoffs: " << result.cutoffs << " on the first move "
+            << result.firstMoveCutoffs * 100 / std::max(result.cutoffs, 1ULL) << "%" << std::endl;
+        std::cout << "Aspiration re-searches: fail low " << result.aspirationFailLows
+            << " fail high " << result.aspirationFailHighs << std::endl;
+    }
+};
+
+#endif
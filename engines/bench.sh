@@ -0,0 +1,11 @@
+#!/bin/sh
+# Benchmark with magic sliding attacks, run with USE_PEXT=1 to also measure PEXT ones(needs a BMI2 CPU)
+# Add -DNO_TT_PREFETCH to the flags to measure without TT prefetching, pass a hash size to search with TT
+# Add -DNO_ASPIRATION to measure the iterative deepening with full root windows
+set -e
+g++ -O2 -pthread -std=c++20 /app/engines/bench.cpp -o /app/engines/bench.out
+/app/engines/bench.out "$@"
+if [ "$USE_PEXT" = "1" ]; then
+    g++ -O2 -mbmi2 -DUSE_PEXT -pthread -std=c++20 /app/engines/bench.cpp -o /app/engines/bench.out
+    /app/engines/bench.out "$@"
+fi
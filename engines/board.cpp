@@ -4,9 +4,9 @@
 #include<string>
 #include<bitset>
 #include<iterator>
-#include<map>
-#include<vector>
 #include<chrono>
+#include<cassert>
+#include<algorithm>
 
 #include "board.hpp"
 #include "definitions.hpp"
@@ -15,125 +15,70 @@
 
 using std::string;
 using std::array;
-using std::map;
-using std::vector;
 
 short int Board::getDirection(playerType player) {
     return player == WHITE ? -1 : 1;
 }
 
-boardType Board::getPawnMoves(boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea) {
-    boardType allPieces = whitePieces | blackPieces;
-    boardType nonCaptures = boardType(0);
-    boardType captures = boardType(0);
-    boardType enemyPieces = (player == BLACK) ? whitePieces : blackPieces;
-    
-    if (this->enPassantSquare != INVALID_POS)
-        enemyPieces.set(this->enPassantSquare);
-
-    // Normal Move
-    uint8_t nextMove = pos + getDirection(player) * 8;
-    if (!(allPieces[nextMove]) && nextMove < 64) {
-        nonCaptures.set(nextMove);
-    }
+void Board::putPiece(uint8_t pos, char piece) {
+    playerType color = getPlayer(piece);
+    _board[pos] = piece;
+    pieceBoards[color][getPieceType(piece)].set(pos);
+    colorBoards[color].set(pos);
+}
 
-    // Double Move at initial position
-    nextMove = pos + getDirection(player) * 16;
-    uint8_t intermediateSquare = pos + getDirection(player) * 8;
-    if (player == BLACK && pos / 8 == 1 && !allPieces[intermediateSquare] && !allPieces[nextMove] && nextMove < 64) {
-        nonCaptures.set(nextMove);
-    } else if (player == WHITE && pos / 8 == 6 && !allPieces[intermediateSquare] && !allPieces[nextMove] && nextMove < 64) {
-        nonCaptures.set(nextMove);
+void Board::removePiece(uint8_t pos) {
+    if (_board[pos] == ' ') {
+        return;
     }
+    playerType color = getPlayer(_board[pos]);
+    pieceBoards[color][getPieceType(_board[pos])].reset(pos);
+    colorBoards[color].reset(pos);
+    _board[pos] = ' ';
+}
 
-    // Capture Left
-    nextMove = pos + getDirection(player) * 8 - 1;
-    if (pos % 8 != 0 && nextMove < 64) {
-        captures.set(nextMove);
-    }
-    // Capture Right
-    nextMove = pos + getDirection(player) * 8 + 1;
-    if (pos % 8 != 7 && nextMove < 64) {
-        captures.set(nextMove);
-    }
+boardType Board::getPawnMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea) {
+    boardType captures = data->pawnAttacks[player][pos];
     if (isAttackArea) {
         return captures;
     }
-    captures &= enemyPieces;
-    nonCaptures &= ~allPieces;
-    return captures | nonCaptures;
-}
-
-boardType Board::getKnightMoves(boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea) {
-    boardType* ownPieces = (player == BLACK) ? &blackPieces : &whitePieces;;
-    boardType movesBoard = boardType(0);
-
-    // Left Moves
-    if (pos % 8 > 0) {
-        if (pos / 8 < 6) 
-            movesBoard.set(pos + 15);
-        if (pos / 8 > 1)
-            movesBoard.set(pos - 17);
-        
-        if (pos % 8 > 1) {
-            if (pos / 8 > 0)
-                movesBoard.set(pos - 10);
-            if (pos / 8 < 7)
-                movesBoard.set(pos + 6);
-        }
-    }
+    boardType emptySquares = ~getAllPieces();
+    boardType enemyPieces = colorBoards[!player];
+    if (this->enPassantSquare != INVALID_POS)
+        enemyPieces.set(this->enPassantSquare);
 
-    // Right Moves
-    if (pos % 8 < 7) {
-        if (pos / 8 > 1)
-            movesBoard.set(pos - 15);
-        if (pos / 8 < 6)
-            movesBoard.set(pos + 17);
+    boardType nonCaptures = data->pawnPushes[player][pos] & emptySquares;
+    if (nonCaptures.any()) {
+        // Double Move at initial position
+        nonCaptures |= data->pawnDoublePushes[player][pos] & emptySquares;
+    }
+    return (captures & enemyPieces) | nonCaptures;
+}
 
-        if (pos % 8 < 6) {
-            if (pos / 8 < 7) 
-                movesBoard.set(pos + 10);                      
-            if (pos / 8 > 0)
-                movesBoard.set(pos - 6);
-        }
+boardType Board::getPawnAttacks(playerType player) {
+    // Attacks of all pawns of player at once
+    const boardType fileA = boardType(0x0101010101010101ULL);
+    const boardType fileH = boardType(0x8080808080808080ULL);
+    boardType pawns = pieceBoards[player][PAWN];
+    if (player == WHITE) {
+        return ((pawns & ~fileA) >> 9) | ((pawns & ~fileH) >> 7);
     }
+    return ((pawns & ~fileA) << 7) | ((pawns & ~fileH) << 9);
+}
+
+boardType Board::getKnightMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea) {
     if (isAttackArea) {
-        return movesBoard;
-    }    
-    movesBoard &= ~*ownPieces;
-    
-    return movesBoard;
+        return data->knightAttacks[pos];
+    }
+    return data->knightAttacks[pos] & ~colorBoards[player];
 }
 
-boardType Board::getKingMoves(boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea) {
+boardType Board::getKingMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea) {
     // DOES NOT INCLUDE CASTLING
-    boardType* ownPieces = (player == BLACK) ? &blackPieces : &whitePieces;
-    boardType movesBoard = boardType(0);
-
-    if (pos / 8 != 0)
-        movesBoard.set(pos - 8);
-    if (pos / 8 != 7)
-        movesBoard.set(pos + 8);
-        
-    if (pos % 8 != 0) {
-        movesBoard.set(pos - 1);
-        if (pos / 8 != 0)
-            movesBoard.set(pos - 9);
-        if (pos / 8 != 7)
-            movesBoard.set(pos + 7);
-    }
-
-    if (pos % 8 != 7) {
-        movesBoard.set(pos + 1);
-        if (pos / 8 != 0)
-            movesBoard.set(pos - 7);
-        if (pos / 8 != 7)
-            movesBoard.set(pos + 9);
-    }
     if (isAttackArea) {
-        return movesBoard;
+        return data->kingAttacks[pos];
     }
-    return movesBoard & ~*ownPieces;
+    return data->kingAttacks[pos] & ~colorBoards[player];
 }
 
 uint16_t Board::getMagicHash(boardType &board, unsigned long long magic, boardType& blockerMask, bool isBishop) {
@@ -141,116 +86,122 @@ uint16_t Board::getMagicHash(boardType &board, unsigned long long magic, boardTy
     return ((board & blockerMask).to_ullong() * magic) >> (64 - (isBishop ? 9 : 12));
 }
 
-boardType Board::getBishopMoves(preCalculation::preCalcType data, boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea) {
-    boardType allPieces = whitePieces | blackPieces;
-    boardType* ownPieces = (player == WHITE) ? &whitePieces : &blackPieces;
-    uint16_t index = getMagicHash(allPieces, data->bishopMagic[pos], data->bishopBlockers[pos], true);
-    boardType allMoves = data->bishopLookup[pos][index];
+boardType Board::getBishopAttacks(preCalculation::preCalcType &data, uint8_t pos, boardType occupancy) {
+#ifdef USE_PEXT
+    return data->bishopPextLookup[pos][_pext_u64(occupancy.to_ullong(), data->bishopBlockers[pos].to_ullong())];
+#else
+    uint16_t index = getMagicHash(occupancy, data->bishopMagic[pos], data->bishopBlockers[pos], true);
+    return data->bishopLookup[pos][index];
+#endif
+}
+
+boardType Board::getRookAttacks(preCalculation::preCalcType &data, uint8_t pos, boardType occupancy) {
+#ifdef USE_PEXT
+    return data->rookPextLookup[pos][_pext_u64(occupancy.to_ullong(), data->rookBlockers[pos].to_ullong())];
+#else
+    uint16_t index = getMagicHash(occupancy, data->rookMagic[pos], data->rookBlockers[pos], false);
+    return data->rookLookup[pos][index];
+#endif
+}
+
+boardType Board::getBishopMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea) {
+    boardType allMoves = getBishopAttacks(data, pos, getAllPieces());
     if (isAttackArea) {
         return allMoves;
     }
-    return allMoves & ~*ownPieces;
+    return allMoves & ~colorBoards[player];
 }
 
-boardType Board::getRookMoves(preCalculation::preCalcType data, boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea) {
-    boardType allPieces = whitePieces | blackPieces;
-    boardType* ownPieces = (player == WHITE) ? &whitePieces : &blackPieces;
-    uint16_t index = getMagicHash(allPieces, data->rookMagic[pos], data->rookBlockers[pos], false);
-    boardType allMoves = data->rookLookup[pos][index];
+boardType Board::getRookMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea) {
+    boardType allMoves = getRookAttacks(data, pos, getAllPieces());
     if (isAttackArea) {
         return allMoves;
     }
-    return allMoves & ~*ownPieces;
+    return allMoves & ~colorBoards[player];
 }
 
-boardType Board::getQueenMoves(preCalculation::preCalcType data, boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea) {
-    return getRookMoves(data, whitePieces, blackPieces, player, pos, isAttackArea) | getBishopMoves(data, whitePieces, blackPieces, player, pos, isAttackArea);
+boardType Board::getQueenMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea) {
+    return getRookMoves(data, player, pos, isAttackArea) | getBishopMoves(data, player, pos, isAttackArea);
 }
 
-boardType Board::getCastlingMoves(preCalculation::preCalcType preCalculatedData, uint8_t kingPos, bool isLeftClear, bool isRightClear) {
+boardType Board::getCastlingMoves(boardType enemyAttacks, uint8_t kingPos, bool isLeftClear, bool isRightClear) {
     // Will check legality too, as castle can't pass through check
-
     boardType castlingMoves = boardType(0);
-    boardType enemyAttacks = boardType(0);
-    map<uint8_t, boardType> enemyMoves = getNextMoves(preCalculatedData, !player, true);
 
-    for (auto itr = enemyMoves.begin(); itr != enemyMoves.end() && (isLeftClear || isRightClear); itr++) {
-        enemyAttacks |= itr->second;
-        if (enemyAttacks[kingPos]) {
-            // King can't be in check
-            return boardType(0);
-        }
-        if (enemyAttacks[kingPos - 1] || enemyAttacks[kingPos - 2] || enemyAttacks[kingPos - 3]) {
-            isLeftClear = false;
-        } 
-        if (enemyAttacks[kingPos + 1] || enemyAttacks[kingPos + 2]) {
-            isRightClear = false;
-        }
+    if (enemyAttacks[kingPos]) {
+        // King can't be in check
+        return castlingMoves;
     }
-
-    if (castlingRights[player][0] && isLeftClear) {
+    if (castlingRights[player][0] && isLeftClear && !enemyAttacks[kingPos - 1] && !enemyAttacks[kingPos - 2]) {
         castlingMoves.set(kingPos - 2);
     }
-    if (castlingRights[player][1] && isRightClear) {
+    if (castlingRights[player][1] && isRightClear && !enemyAttacks[kingPos + 1] && !enemyAttacks[kingPos + 2]) {
         castlingMoves.set(kingPos + 2);
     }
     return castlingMoves;
 }
 
-void Board::calcZobristHash(prnType &PRN) {
-    zobristHash = 0;
+unsigned long long Board::computeZobristHash(prnType &PRN) {
+    // Full recalculation, the incremental hash kept by makeMove must always match this
+    unsigned long long hash = 0;
     for (uint8_t i=0; i < 64; i++) {
-        if (_board[i] == ' ') {
-            continue;
-        }
-        char piece = tolower(_board[i]);
-        if (piece == 'p') {
-            zobristHash ^= PRN[prnPawnValStart + getPlayer(_board[i]) * i];
-        } else if (piece == 'n') {
-            zobristHash ^= PRN[prnKnightValStart + getPlayer(_board[i]) * i];
-        } else if (piece == 'b') {
-            zobristHash ^= PRN[prnBishopValStart + getPlayer(_board[i]) * i];
-        } else if (piece == 'r') {
-            zobristHash ^= PRN[prnRookValStart + getPlayer(_board[i]) * i];
-        } else if (piece == 'q') {
-            zobristHash ^= PRN[prnQueenValStart + getPlayer(_board[i]) * i];
-        } else if (piece == 'k') {
-            zobristHash ^= PRN[prnKingValStart + getPlayer(_board[i]) * i];
+        if (_board[i] != ' ') {
+            hash ^= PRN[getZobristIndex(_board[i], i)];
         }
     }
 
     if (player == BLACK)
-        zobristHash ^= PRN[prnBoardEnds];
+        hash ^= PRN[prnBoardEnds];
 
-    zobristHash ^= PRN[prnBoardEnds + (uint8_t)castlingRights[0][0]];
+    hash ^= PRN[getCastlingZobristIndex(BLACK, 0, castlingRights[BLACK][0])];
 
-    zobristHash ^= PRN[prnBoardEnds + 2 + (uint8_t)castlingRights[0][1]];
+    hash ^= PRN[getCastlingZobristIndex(BLACK, 1, castlingRights[BLACK][1])];
 
-    zobristHash ^= PRN[prnBoardEnds + 4 + (uint8_t)castlingRights[1][0]];
+    hash ^= PRN[getCastlingZobristIndex(WHITE, 0, castlingRights[WHITE][0])];
 
-    zobristHash ^= PRN[prnBoardEnds + 6 + (uint8_t)castlingRights[1][1]];
+    hash ^= PRN[getCastlingZobristIndex(WHITE, 1, castlingRights[WHITE][1])];
     
     if (enPassantSquare != INVALID_POS) {
-        zobristHash ^= PRN[prnEnPassantStart + enPassantSquare % 8];
+        hash ^= PRN[prnEnPassantStart + enPassantSquare % 8];
+    }
+    return hash;
+}
+
+unsigned long long Board::computePawnHash(prnType &PRN) {
+    // Full recalculation of the pawn only hash
+    unsigned long long hash = 0;
+    for (uint8_t color=BLACK; color <= WHITE; color++) {
+        boardType pawns = pieceBoards[color][PAWN];
+        for (uint8_t pos=pawns._Find_first(); pos < 64; pos=pawns._Find_next(pos)) {
+            hash ^= PRN[getZobristIndex(_board[pos], pos)];
+        }
     }
+    return hash;
+}
+
+void Board::calcZobristHash(prnType &PRN) {
+    zobristHash = computeZobristHash(PRN);
+    pawnHash = computePawnHash(PRN);
 }
 
-void Board::parseCastlingRights(int &index) {
+void Board::parseCastlingRights(const string &fen, int &index) {
     // Convert String(KQkQ) to array
+    castlingRights[BLACK][0] = castlingRights[BLACK][1] = false;
+    castlingRights[WHITE][0] = castlingRights[WHITE][1] = false;
     if (fen[index] != '-') {
-        for (;fen[index] != ' '; index++) {
+        for (;index < fen.size() && fen[index] != ' '; index++) {
             switch (fen[index]) {
                 case 'K':
-                    castlingRights[WHITE][0] = true;
+                    castlingRights[WHITE][1] = true;
                     break;
                 case 'Q':
-                    castlingRights[WHITE][1] = true;
+                    castlingRights[WHITE][0] = true;
                     break;
                 case 'k':
-                    castlingRights[BLACK][0] = true;
+                    castlingRights[BLACK][1] = true;
                     break;
                 case 'q':
-                    castlingRights[BLACK][1] = true;
+                    castlingRights[BLACK][0] = true;
             }
         }
     } else {
@@ -259,9 +210,9 @@ void Board::parseCastlingRights(int &index) {
     }
 }
 
-uint16_t Board::parseIntInFEN(int &index) {
+uint16_t Board::parseIntInFEN(const string &fen, int &index) {
     uint16_t num = 0;
-    for (; fen[index] != ' '; index++) {
+    for (; index < fen.size() && fen[index] != ' '; index++) {
         num *= 10;
         num += fen[index] - '0';
     }
@@ -285,16 +236,40 @@ playerType Board::getPlayer(char piece) {
     return WHITE;
 }
 
+uint8_t Board::getPieceType(char piece) {
+    switch (tolower(piece)) {
+        case 'p':
+            return PAWN;
+        case 'n':
+            return KNIGHT;
+        case 'b':
+            return BISHOP;
+        case 'r':
+            return ROOK;
+        case 'q':
+            return QUEEN;
+        case 'k':
+            return KING;
+    }
+    return NO_PIECE;
+}
+
 char Board::pieceAt(uint8_t pos) {
     return this->_board[pos];
 }
 
-void Board::parseFen() {
+void Board::parseFen(const string &fen) {
     for (uint8_t j=0; j < 64; j++) {
         _board[j] = ' ';
     }
+    for (uint8_t color=0; color < 2; color++) {
+        colorBoards[color].reset();
+        for (uint8_t pieceType=0; pieceType < 6; pieceType++) {
+            pieceBoards[color][pieceType].reset();
+        }
+    }
     int i, boardIndex=0;
-    for (i=0; fen[i] != ' '; i++) {
+    for (i=0; i < fen.size() && fen[i] != ' '; i++) {
         if (fen[i] == '/')
             continue;
         if (fen[i] > '0' && fen[i] < '9') {
@@ -302,24 +277,25 @@ void Board::parseFen() {
             boardIndex += fen[i] - '0';
         } else {
             // Piece
-            _board[boardIndex] = fen[i];
+            putPiece(boardIndex, fen[i]);
             boardIndex++;
         }
     }
     player = fen[++i] == 'b' ? BLACK : WHITE;
     i += 2; // Shift to castling
-    parseCastlingRights(i);
+    parseCastlingRights(fen, i);
     i++;  // Eat Space
     if (fen[i] != '-') {
         enPassantSquare = parseNotation(fen.substr(i, 2));
         i += 2;
     } else {
         enPassantSquare = INVALID_POS;
-        i++; // Eat Space
+        i++;
     }
-    halfMoves = (uint8_t) parseIntInFEN(i);
     i++; // Eat Space
-    fullMoves = parseIntInFEN(i);
+    halfMoves = (uint8_t) parseIntInFEN(fen, i);
+    i++; // Eat Space
+    fullMoves = parseIntInFEN(fen, i);
 }
 
 Board::Board() {
@@ -327,202 +303,344 @@ Board::Board() {
 }
 
 Board::Board(string _fen, prnType& PRN) {
-    fen = _fen;
+    parseFen(_fen);
     calcZobristHash(PRN);
-    parseFen();
 }
 
-Board::Board(const Board &original) {
-    this->fen = original.fen;
-    this->zobristHash = original.zobristHash;
-    parseFen();
+bool Board::isCapture(moveType move) {
+    return this->pieceAt(moveUtils::getTarget(move)) != ' ' || moveUtils::getFlag(move) == MOVE_EN_PASSANT;
 }
 
-bool Board::isCapture(moveType move) {
-    return this->pieceAt(move[1]) != ' ';
+void Board::addMoves(MoveList &moves, uint8_t origin, boardType targets) {
+    for (uint8_t i = targets._Find_first(); i < 64; i = targets._Find_next(i)) {
+        moves.push(moveUtils::create(origin, i));
+    }
 }
 
-map<uint8_t, boardType> Board::getNextMoves(preCalculation::preCalcType preCalculatedData, playerType player, bool quick) {
-    // PSUEDO LEGAL ONLY, DOES NOT CHECK FOR LEGALITY
-    boardType whitePieces = boardType(0), blackPieces = boardType(0);
-    // King not found intially
-    uint8_t kingPos = INVALID_POS;
-    map<uint8_t, boardType> moves = map<uint8_t, boardType>();
-    vector<uint8_t> playerSquares = vector<uint8_t>();
-    for (uint8_t i=0; i < 64; i++) {
-        if (_board[i] == ' ')
-            continue;
-        if (getPlayer(_board[i]) == WHITE)
-            whitePieces.set(i);
-        else
-            blackPieces.set(i);
-        if (getPlayer(_board[i]) == player)
-            playerSquares.push_back(i);
-    }
-
-    for (auto i=playerSquares.begin(); i != playerSquares.end(); i++) {
-        char piece = tolower(_board[*i]);
-        if (piece == 'p') {
-            moves[*i] = getPawnMoves(whitePieces, blackPieces, player, *i);
-        } else if (piece == 'n') {
-            moves[*i] = getKnightMoves(whitePieces, blackPieces, player, *i);
-        } else if (piece == 'b') {
-            moves[*i] = getBishopMoves(preCalculatedData, whitePieces, blackPieces, player, *i);
-        } else if (piece == 'r') {
-            moves[*i] = getRookMoves(preCalculatedData, whitePieces, blackPieces, player, *i);
-        } else if (piece == 'q') {
-            moves[*i] = getQueenMoves(preCalculatedData, whitePieces, blackPieces, player, *i);
-        } else if (piece == 'k') {
-            moves[*i] = getKingMoves(whitePieces, blackPieces, player, *i);
-            kingPos = *i;
+void Board::addPawnMoves(MoveList &moves, uint8_t origin, boardType targets) {
+    for (uint8_t i = targets._Find_first(); i < 64; i = targets._Find_next(i)) {
+        if (i / 8 == 0 || i / 8 == 7) {
+            for (uint8_t piece = QUEEN; piece >= KNIGHT; piece--) {
+                moves.push(moveUtils::create(origin, i, MOVE_PROMOTION, piece));
+            }
+        } else if (i == enPassantSquare) {
+            moves.push(moveUtils::create(origin, i, MOVE_EN_PASSANT));
+        } else {
+            moves.push(moveUtils::create(origin, i));
+        }
+    }
+}
+
+boardType Board::getAttackersOf(preCalculation::preCalcType &data, uint8_t pos, playerType attacker, boardType occupancy) {
+    // A piece on pos attacks exactly the squares the same piece type could attack it from
+    boardType queens = pieceBoards[attacker][QUEEN];
+    return (data->pawnAttacks[!attacker][pos] & pieceBoards[attacker][PAWN])
+        | (data->knightAttacks[pos] & pieceBoards[attacker][KNIGHT])
+        | (data->kingAttacks[pos] & pieceBoards[attacker][KING])
+        | (getBishopAttacks(data, pos, occupancy) & (pieceBoards[attacker][BISHOP] | queens))
+        | (getRookAttacks(data, pos, occupancy) & (pieceBoards[attacker][ROOK] | queens));
+}
+
+boardType Board::getPinnedPieces(preCalculation::preCalcType &data, playerType player, uint8_t kingPos) {
+    // Pinned pieces may only move along the line through the king and themselves
+    boardType pinned = boardType(0);
+    boardType enemyPieces = colorBoards[!player];
+    boardType queens = pieceBoards[!player][QUEEN];
+    boardType snipers = (getRookAttacks(data, kingPos, enemyPieces) & (pieceBoards[!player][ROOK] | queens))
+        | (getBishopAttacks(data, kingPos, enemyPieces) & (pieceBoards[!player][BISHOP] | queens));
+    boardType allPieces = getAllPieces();
+    for (uint8_t i = snipers._Find_first(); i < 64; i = snipers._Find_next(i)) {
+        boardType blockers = data->between[kingPos][i] & allPieces;
+        if (blockers.count() == 1) {
+            pinned |= blockers & colorBoards[player];
+        }
+    }
+    return pinned;
+}
+
+bool Board::isEnPassantLegal(preCalculation::preCalcType &data, uint8_t origin, uint8_t kingPos) {
+    // Both pawns leave their squares at once, which can expose the king along the rank
+    uint8_t capturedPos = enPassantSquare - getDirection(player) * 8;
+    boardType occupancy = getAllPieces();
+    occupancy.reset(origin);
+    occupancy.reset(capturedPos);
+    occupancy.set(enPassantSquare);
+    boardType attackers = getAttackersOf(data, kingPos, !player, occupancy);
+    attackers.reset(capturedPos);
+    return attackers.none();
+}
+
+void Board::getNextMoves(preCalculation::preCalcType &preCalculatedData, MoveList &moves, playerType player, uint8_t genType) {
+    // Legal moves only, checks and pins are resolved once per position instead of per move
+    boardType enemyPieces = colorBoards[!player];
+    boardType emptySquares = ~getAllPieces();
+    boardType targetMask = enemyPieces | emptySquares;
+    boardType pawnTargetMask = targetMask;
+    if (genType == GEN_CAPTURES) {
+        targetMask = enemyPieces;
+        pawnTargetMask = enemyPieces;
+        if (enPassantSquare != INVALID_POS)
+            pawnTargetMask.set(enPassantSquare);
+    } else if (genType == GEN_QUIETS) {
+        targetMask = emptySquares;
+        pawnTargetMask = emptySquares;
+        if (enPassantSquare != INVALID_POS)
+            pawnTargetMask.reset(enPassantSquare);
+    }
+    boardType kingTargetMask = targetMask;
+
+    uint8_t kingPos = findKing(player);
+    boardType checkers = boardType(0);
+    boardType enemyAttacks = boardType(0);
+    boardType pinned = boardType(0);
+    if (kingPos != INVALID_POS) {
+        boardType allPieces = getAllPieces();
+        checkers = getAttackersOf(preCalculatedData, kingPos, !player, allPieces);
+        // The king can't step back along the ray of a slider checking it
+        allPieces.reset(kingPos);
+        enemyAttacks = getAttackArea(preCalculatedData, !player, allPieces);
+        kingTargetMask &= ~enemyAttacks;
+        pinned = getPinnedPieces(preCalculatedData, player, kingPos);
+    }
+
+    if (checkers.count() < 2) {
+        if (checkers.any()) {
+            // Capture the checker or block it
+            boardType checkMask = preCalculatedData->between[kingPos][checkers._Find_first()] | checkers;
+            targetMask &= checkMask;
+            pawnTargetMask &= checkMask;
+        }
+        boardType pieces;
+
+        pieces = pieceBoards[player][PAWN];
+        for (uint8_t i = pieces._Find_first(); i < 64; i = pieces._Find_next(i)) {
+            boardType pawnMoves = getPawnMoves(preCalculatedData, player, i);
+            boardType targets = pawnMoves & pawnTargetMask;
+            if (pinned[i]) {
+                targets &= preCalculatedData->line[kingPos][i];
+            }
+            if (enPassantSquare != INVALID_POS && pawnMoves[enPassantSquare] && genType != GEN_QUIETS) {
+                // Checks and pins of en passant are decided on the resulting position
+                targets.set(enPassantSquare, kingPos == INVALID_POS || isEnPassantLegal(preCalculatedData, i, kingPos));
+            }
+            addPawnMoves(moves, i, targets);
+        }
+        pieces = pieceBoards[player][KNIGHT] & ~pinned;
+        for (uint8_t i = pieces._Find_first(); i < 64; i = pieces._Find_next(i)) {
+            addMoves(moves, i, getKnightMoves(preCalculatedData, player, i) & targetMask);
+        }
+        pieces = pieceBoards[player][BISHOP];
+        for (uint8_t i = pieces._Find_first(); i < 64; i = pieces._Find_next(i)) {
+            addMoves(moves, i, getBishopMoves(preCalculatedData, player, i) & targetMask & (pinned[i] ? preCalculatedData->line[kingPos][i] : ~boardType(0)));
+        }
+        pieces = pieceBoards[player][ROOK];
+        for (uint8_t i = pieces._Find_first(); i < 64; i = pieces._Find_next(i)) {
+            addMoves(moves, i, getRookMoves(preCalculatedData, player, i) & targetMask & (pinned[i] ? preCalculatedData->line[kingPos][i] : ~boardType(0)));
+        }
+        pieces = pieceBoards[player][QUEEN];
+        for (uint8_t i = pieces._Find_first(); i < 64; i = pieces._Find_next(i)) {
+            addMoves(moves, i, getQueenMoves(preCalculatedData, player, i) & targetMask & (pinned[i] ? preCalculatedData->line[kingPos][i] : ~boardType(0)));
         }
     }
-    if (quick || kingPos == INVALID_POS) {
-        return moves;
+    if (kingPos == INVALID_POS) {
+        return;
     }
+    addMoves(moves, kingPos, getKingMoves(preCalculatedData, player, kingPos) & kingTargetMask);
 
-    // Saves ~10us of function calling overhead if preliminary checks are done here
-    boardType allPieces = whitePieces | blackPieces;
-    bool isLeftClear = !allPieces[kingPos - 1] && !allPieces[kingPos - 2] && !allPieces[kingPos - 3];
-    bool isRightClear = !allPieces[kingPos + 1] && !allPieces[kingPos + 2];
-    bool isCastlePossible = (castlingRights[player][0] || castlingRights[player][1])
-        && (player == BLACK && kingPos == 4 || player == WHITE && kingPos == 60)
-        && (isLeftClear || isRightClear);
+    if (genType == GEN_CAPTURES || checkers.any()) {
+        return;
+    }
 
-    if (isCastlePossible) {
-        moves[kingPos] |= getCastlingMoves(preCalculatedData, kingPos, isLeftClear, isRightClear);
+    bool isOnInitialSquare = player == BLACK && kingPos == 4 || player == WHITE && kingPos == 60;
+    if (isOnInitialSquare && (castlingRights[player][0] || castlingRights[player][1])) {
+        // Saves ~10us of function calling overhead if preliminary checks are done here
+        boardType allPieces = getAllPieces();
+        bool isLeftClear = !allPieces[kingPos - 1] && !allPieces[kingPos - 2] && !allPieces[kingPos - 3];
+        bool isRightClear = !allPieces[kingPos + 1] && !allPieces[kingPos + 2];
+        boardType castlingMoves = getCastlingMoves(enemyAttacks, kingPos, isLeftClear, isRightClear);
+        for (uint8_t i = castlingMoves._Find_first(); i < 64; i = castlingMoves._Find_next(i)) {
+            moves.push(moveUtils::create(kingPos, i, MOVE_CASTLING));
+        }
     }
+}
 
-    return moves;
+boardType Board::getAttackArea(preCalculation::preCalcType &preCalculatedData, playerType player) {
+    return getAttackArea(preCalculatedData, player, getAllPieces());
 }
 
-boardType Board::getAttackArea(preCalculation::preCalcType preCalculatedData, playerType player) {
-    boardType whitePieces = boardType(0), blackPieces = boardType(0), attackArea = boardType(0);
-    vector<uint8_t> playerSquares = vector<uint8_t>();
-    for (uint8_t i=0; i < 64; i++) {
-        if (_board[i] == ' ')
-            continue;
-        if (getPlayer(_board[i]) == WHITE)
-            whitePieces.set(i);
-        else
-            blackPieces.set(i);
-        if (getPlayer(_board[i]) == player)
-            playerSquares.push_back(i);
-    }
-    for (auto &square: playerSquares) {
-        char piece = tolower(_board[square]);
-        if (piece == 'p') {
-           attackArea |= getPawnMoves(whitePieces, blackPieces, player, square, true);
-        } else if (piece == 'n') {
-            attackArea |= getKnightMoves(whitePieces, blackPieces, player, square, true);
-        } else if (piece == 'b') {
-            attackArea |= getBishopMoves(preCalculatedData, whitePieces, blackPieces, player, square, true);
-        } else if (piece == 'r') {
-            attackArea |= getRookMoves(preCalculatedData, whitePieces, blackPieces, player, square, true);
-        } else if (piece == 'q') {
-            attackArea |= getQueenMoves(preCalculatedData, whitePieces, blackPieces, player, square, true);
-        } else if (piece == 'k') {
-            attackArea |= getKingMoves(whitePieces, blackPieces, player, square, true);
-        }
+boardType Board::getAttackArea(preCalculation::preCalcType &preCalculatedData, playerType player, boardType occupancy) {
+    boardType attackArea = getPawnAttacks(player);
+    boardType pieces;
+
+    pieces = pieceBoards[player][KNIGHT];
+    for (uint8_t i = pieces._Find_first(); i < 64; i = pieces._Find_next(i)) {
+        attackArea |= preCalculatedData->knightAttacks[i];
+    }
+    pieces = pieceBoards[player][BISHOP] | pieceBoards[player][QUEEN];
+    for (uint8_t i = pieces._Find_first(); i < 64; i = pieces._Find_next(i)) {
+        attackArea |= getBishopAttacks(preCalculatedData, i, occupancy);
+    }
+    pieces = pieceBoards[player][ROOK] | pieceBoards[player][QUEEN];
+    for (uint8_t i = pieces._Find_first(); i < 64; i = pieces._Find_next(i)) {
+        attackArea |= getRookAttacks(preCalculatedData, i, occupancy);
+    }
+    pieces = pieceBoards[player][KING];
+    for (uint8_t i = pieces._Find_first(); i < 64; i = pieces._Find_next(i)) {
+        attackArea |= preCalculatedData->kingAttacks[i];
     }
     return attackArea;
 }
 
-vector<moveType> Board::orderedNextMoves(preCalculation::preCalcType preCalculatedData, playerType player) {
-    map<uint8_t, boardType> nextMoves = this->getNextMoves(preCalculatedData, player, false);
-    vector<moveType> captures;
-    vector<moveType> nonCaptures;
+void Board::orderedNextMoves(preCalculation::preCalcType &preCalculatedData, MoveList &moves, playerType player) {
+    // Captures by MVV-LVA before non captures
+    getNextMoves(preCalculatedData, moves, player, GEN_CAPTURES);
+    orderCaptures(moves);
+    getNextMoves(preCalculatedData, moves, player, GEN_QUIETS);
+}
 
-    for (auto itr = nextMoves.begin(); itr != nextMoves.end(); itr++) {
-        for (uint8_t i = itr->second._Find_first(); i < 64; i = itr->second._Find_next(i)) {
-            moveType currentMove = {itr->first, i};
-            if (isCapture(currentMove)) {
-                captures.push_back(currentMove);
-            } else {
-                nonCaptures.push_back(currentMove);
-            }
-        }
+uint8_t Board::getCapturedPieceType(moveType move) {
+    if (moveUtils::getFlag(move) == MOVE_EN_PASSANT) {
+        return PAWN;
     }
-    // Add non captures to end of captures
-    captures.insert(captures.end(), nonCaptures.begin(), nonCaptures.end());
-    return captures;
+    char captured = _board[moveUtils::getTarget(move)];
+    return captured == ' ' ? NO_PIECE : getPieceType(captured);
 }
 
-uint8_t Board::findKing(playerType player) {
-    char target = player == BLACK ? 'k' : 'K';
-    if (_board[4] == target) {
-        return 4;
+void Board::orderCaptures(MoveList &moves) {
+    // Most valuable victim first, the least valuable attacker breaks ties
+    moves.sortByScore(0, [this](moveType move) -> uint32_t {
+        uint8_t victim = getCapturedPieceType(move);
+        return (victim == NO_PIECE ? 0 : victim + 1) * 8 + KING - getPieceType(_board[moveUtils::getOrigin(move)]);
+    });
+}
+
+int Board::see(preCalculation::preCalcType &data, moveType move) {
+    // Static exchange evaluation, material won on the target square by the side making the move
+    // if both sides keep recapturing with their least valuable piece while it pays off. Pins are ignored
+    if (moveUtils::getFlag(move) == MOVE_CASTLING) {
+        return 0;
+    }
+    uint8_t origin = moveUtils::getOrigin(move), target = moveUtils::getTarget(move);
+    int gain[32];
+    uint8_t exchanges = 0;
+    gain[0] = seeValues[getCapturedPieceType(move)];
+    uint8_t pieceOnTarget = getPieceType(_board[origin]);
+    if (moveUtils::getFlag(move) == MOVE_PROMOTION) {
+        pieceOnTarget = moveUtils::getPromotionPiece(move);
+        gain[0] += seeValues[pieceOnTarget] - seeValues[PAWN];
     }
-    if (_board[60] == target) {
-        return 60;
+
+    boardType occupancy = getAllPieces();
+    occupancy.reset(origin);
+    if (moveUtils::getFlag(move) == MOVE_EN_PASSANT) {
+        occupancy.reset(player == WHITE ? target + 8 : target - 8);
     }
-    for (int i=0; i < 64; i++) {
-        if (_board[i] == target) {
-            return i;
+    boardType diagonalSliders = pieceBoards[WHITE][BISHOP] | pieceBoards[BLACK][BISHOP] | pieceBoards[WHITE][QUEEN] | pieceBoards[BLACK][QUEEN];
+    boardType straightSliders = pieceBoards[WHITE][ROOK] | pieceBoards[BLACK][ROOK] | pieceBoards[WHITE][QUEEN] | pieceBoards[BLACK][QUEEN];
+    boardType attackers = (getAttackersOf(data, target, WHITE, occupancy) | getAttackersOf(data, target, BLACK, occupancy)) & occupancy;
+    playerType side = !player;
+    while (exchanges < 31) {
+        boardType sideAttackers = attackers & colorBoards[side];
+        if (sideAttackers.none()) {
+            break;
+        }
+        uint8_t attackerType = PAWN;
+        while ((sideAttackers & pieceBoards[side][attackerType]).none()) {
+            attackerType++;
+        }
+        if (attackerType == KING && (attackers & colorBoards[!side]).any()) {
+            // The king can't capture a defended piece
+            break;
         }
+        exchanges++;
+        gain[exchanges] = seeValues[pieceOnTarget] - gain[exchanges - 1];
+        occupancy.reset((sideAttackers & pieceBoards[side][attackerType])._Find_first());
+        // Sliders behind the piece that just captured join in
+        if (attackerType == PAWN || attackerType == BISHOP || attackerType == QUEEN) {
+            attackers |= getBishopAttacks(data, target, occupancy) & diagonalSliders;
+        }
+        if (attackerType == ROOK || attackerType == QUEEN) {
+            attackers |= getRookAttacks(data, target, occupancy) & straightSliders;
+        }
+        attackers &= occupancy;
+        pieceOnTarget = attackerType;
+        side = !side;
     }
-
-    return INVALID_POS;
+    for (; exchanges > 0; exchanges--) {
+        // Either side may stop capturing
+        gain[exchanges - 1] = -std::max(-gain[exchanges - 1], gain[exchanges]);
+    }
+    return gain[0];
 }
 
-unsigned short Board::getZobristStartIndex(char piece) {
-    piece = tolower(piece);
-    if (piece == 'p') {
-        return prnPawnValStart;
-    } else if (piece == 'n') {
-        return prnKnightValStart;
-    } else if (piece == 'b') {
-        return prnBishopValStart;
-    } else if (piece == 'r') {
-       return prnRookValStart;
-    } else if (piece == 'q') {
-        return prnQueenValStart;
+bool Board::isLosingCapture(preCalculation::preCalcType &data, moveType move) {
+    // Taking a piece worth at least the capturing one can't lose material
+    if (seeValues[getCapturedPieceType(move)] >= seeValues[getPieceType(_board[moveUtils::getOrigin(move)])]) {
+        return false;
     }
-    // else
-    return prnKingValStart;
+    return see(data, move) < 0;
 }
 
-void Board::changeZobristOnMove(prnType &PRN, moveType &move) {
-    if (move[1] == INVALID_POS) {
-        return;
-    }
+uint8_t Board::findKing(playerType player) {
+    uint8_t kingPos = pieceBoards[player][KING]._Find_first();
+    return kingPos < 64 ? kingPos : INVALID_POS;
+}
 
-    unsigned short startIndex = getZobristStartIndex(_board[move[0]]);
-    if (_board[move[1]] != ' ') {
-        unsigned short enemyPieceStartIndex = getZobristStartIndex(_board[move[0]]);
-        // Remove piece from board
-        this->zobristHash ^= PRN[enemyPieceStartIndex + player * move[1]];
+unsigned short Board::getZobristIndex(char piece, uint8_t pos) {
+    playerType color = getPlayer(piece);
+    switch (tolower(piece)) {
+        case 'p':
+            // Pawns never stand on the first or last rank
+            return prnPawnValStart + color * 56 + pos - 8;
+        case 'n':
+            return prnKnightValStart + color * 64 + pos;
+        case 'b':
+            return prnBishopValStart + color * 64 + pos;
+        case 'r':
+            return prnRookValStart + color * 64 + pos;
+        case 'q':
+            return prnQueenValStart + color * 64 + pos;
     }
+    return prnKingValStart + color * 64 + pos;
+}
 
-    // Remove piece from START
-    this->zobristHash ^= PRN[startIndex + player * move[0]];
-    // Add piece to END
-    this->zobristHash ^= PRN[startIndex + player * move[1]];
+unsigned short Board::getCastlingZobristIndex(playerType color, uint8_t side, bool isAvailable) {
+    // 2 numbers for each of the 4 rights, one per value
+    return prnBoardEnds + 1 + 2 * (2 * color + side) + isAvailable;
 }
 
-void Board::changeZobristOnPromotion(prnType &PRN, char piece, uint8_t pos) {
-    unsigned short startIndex = getZobristStartIndex(piece);
-    this->zobristHash ^= PRN[startIndex + player * pos];
+void Board::togglePieceHash(prnType &PRN, char piece, uint8_t pos) {
+    unsigned long long key = PRN[getZobristIndex(piece, pos)];
+    this->zobristHash ^= key;
+    if (getPieceType(piece) == PAWN) {
+        this->pawnHash ^= key;
+    }
 }
 
-void Board::disableQueenSideCastling(prnType &PRN) {
-    if (castlingRights[player][0]) {
-        // Enable false
-        this->zobristHash ^= PRN[prnBoardEnds + 1 + 4 * player];
-        // Disable true
-        this->zobristHash ^= PRN[prnBoardEnds + 1 + 4 * player + 1];
+void Board::disableCastling(prnType &PRN, playerType color, uint8_t side) {
+    if (castlingRights[color][side]) {
+        this->zobristHash ^= PRN[getCastlingZobristIndex(color, side, true)];
+        this->zobristHash ^= PRN[getCastlingZobristIndex(color, side, false)];
     }
-    castlingRights[player][0] = false;
+    castlingRights[color][side] = false;
 }
 
-void Board::disableKingSideCastling(prnType &PRN) {
-    if (castlingRights[player][1]) {
-        // Enable false
-        this->zobristHash ^= PRN[prnBoardEnds + 1 + 4 * player + 2];
-        // Disable true
-        this->zobristHash ^= PRN[prnBoardEnds + 1 + 4 * player + 3];
+void Board::disableCastlingForSquare(prnType &PRN, uint8_t pos) {
+    // A rook leaving or being captured on its initial square
+    switch (pos) {
+        case 0:
+            disableCastling(PRN, BLACK, 0);
+            break;
+        case 7:
+            disableCastling(PRN, BLACK, 1);
+            break;
+        case 56:
+            disableCastling(PRN, WHITE, 0);
+            break;
+        case 63:
+            disableCastling(PRN, WHITE, 1);
+            break;
     }
-    castlingRights[player][1] = false;
 }
 
 string Board::exportFEN() {
@@ -538,11 +656,13 @@ string Board::exportFEN() {
         } else {
             blankSpaces++;
         }
-        if (i % 8 == 7 && i != 63){
+        if (i % 8 == 7){
             if (blankSpaces > 0) {
                 newFen.push_back('0' + blankSpaces);
             }
-            newFen.push_back('/');
+            if (i != 63) {
+                newFen.push_back('/');
+            }
             blankSpaces = 0;
         }
     }
@@ -551,19 +671,19 @@ string Board::exportFEN() {
 
     bool isCastleAvailable = false;
     string castleString = "";
-    if (castlingRights[WHITE][0]) {
+    if (castlingRights[WHITE][1]) {
         castleString.push_back('K');
         isCastleAvailable = true;
     }
-    if (castlingRights[WHITE][1]) {
+    if (castlingRights[WHITE][0]) {
         castleString.push_back('Q');
         isCastleAvailable = true;
     }
-    if (castlingRights[BLACK][0]) {
+    if (castlingRights[BLACK][1]) {
         castleString.push_back('k');
         isCastleAvailable = true;
     }
-    if (castlingRights[BLACK][1]) {
+    if (castlingRights[BLACK][0]) {
         castleString.push_back('q');
         isCastleAvailable = true;
     }
@@ -581,85 +701,144 @@ string Board::exportFEN() {
     return newFen;
 }
 
-void Board::makeMove(moveType move, prnType &PRN, bool isComputer, bool changeFEN) {
-    // Does no validation, make sure move is psuedo legal beforehand
-    bool isHalfMove = _board[move[1]] == ' ';
-    bool isPromotion = false;
-
-    // Castling
-    if (tolower(_board[move[0]]) == 'k' && abs(move[0] - move[1]) == 2) {
-        moveType rookMove;
-        if (move[0] - move[1] == -2) {
-            // King
-            if (player == WHITE) {
-                rookMove = {63, 61};
-            } else {
-                rookMove = {7, 5};
-            }
-        } else if (move[0] - move[1] == 2) {
-            // Queen
-            if (player == WHITE) {
-                rookMove = {56, 58};
-            } else {
-                rookMove = {0, 2};
+Board::UndoRecord& Board::pushUndoRecord() {
+    UndoRecord &record = undoStack[undoCount & (MAX_UNDO_DEPTH - 1)];
+    undoCount++;
+    record.castlingRights[BLACK][0] = castlingRights[BLACK][0];
+    record.castlingRights[BLACK][1] = castlingRights[BLACK][1];
+    record.castlingRights[WHITE][0] = castlingRights[WHITE][0];
+    record.castlingRights[WHITE][1] = castlingRights[WHITE][1];
+    record.enPassantSquare = enPassantSquare;
+    record.halfMoves = halfMoves;
+    record.zobristHash = zobristHash;
+    record.pawnHash = pawnHash;
+    return record;
+}
+
+array<uint8_t, 2> Board::getCastlingRookMove(moveType kingMove) {
+    if (moveUtils::getTarget(kingMove) > moveUtils::getOrigin(kingMove)) {
+        // King
+        if (player == WHITE) {
+            return {63, 61};
+        }
+        return {7, 5};
+    }
+    // Queen
+    if (player == WHITE) {
+        return {56, 59};
+    }
+    return {0, 3};
+}
+
+unsigned long long Board::getKeyAfterMove(moveType move, prnType &PRN) {
+    // The hash makeMove would leave, without touching the board
+    uint8_t origin = moveUtils::getOrigin(move), target = moveUtils::getTarget(move);
+    uint8_t flag = moveUtils::getFlag(move);
+    char movingPiece = _board[origin];
+    char placedPiece = movingPiece;
+    unsigned long long key = zobristHash ^ PRN[prnBoardEnds];
+
+    if (enPassantSquare != INVALID_POS) {
+        key ^= PRN[prnEnPassantStart + enPassantSquare % 8];
+    }
+    if (flag == MOVE_CASTLING) {
+        array<uint8_t, 2> rookMove = getCastlingRookMove(move);
+        key ^= PRN[getZobristIndex(_board[rookMove[0]], rookMove[0])];
+        key ^= PRN[getZobristIndex(_board[rookMove[0]], rookMove[1])];
+    } else if (flag == MOVE_PROMOTION) {
+        const char promotionNames[4] = {'n', 'b', 'r', 'q'};
+        char piece = promotionNames[moveUtils::getPromotionPiece(move) - KNIGHT];
+        placedPiece = player == WHITE ? toupper(piece) : piece;
+    } else if (flag == MOVE_EN_PASSANT) {
+        uint8_t pos = target - getDirection(player) * 8;
+        key ^= PRN[getZobristIndex(_board[pos], pos)];
+    } else if (tolower(movingPiece) == 'p' && abs(origin - target) == 16) {
+        key ^= PRN[prnEnPassantStart + (target - getDirection(player) * 8) % 8];
+    }
+
+    for (playerType color: {BLACK, WHITE}) {
+        for (uint8_t side=0; side < 2; side++) {
+            // Same rules as disableCastling and disableCastlingForSquare
+            uint8_t rookSquare = (color == WHITE ? 56 : 0) + side * 7;
+            bool isLost = origin == rookSquare || target == rookSquare
+                || (color == player && tolower(movingPiece) == 'k');
+            if (castlingRights[color][side] && isLost) {
+                key ^= PRN[getCastlingZobristIndex(color, side, true)];
+                key ^= PRN[getCastlingZobristIndex(color, side, false)];
             }
         }
-        _board[rookMove[1]] = _board[rookMove[0]];
-        _board[rookMove[0]] = ' ';
-        changeZobristOnMove(PRN, rookMove);
-        disableQueenSideCastling(PRN);
-        disableKingSideCastling(PRN);
+    }
+
+    if (_board[target] != ' ') {
+        key ^= PRN[getZobristIndex(_board[target], target)];
+    }
+    key ^= PRN[getZobristIndex(movingPiece, origin)];
+    key ^= PRN[getZobristIndex(placedPiece, target)];
+    return key;
+}
+
+void Board::makeMove(moveType move, prnType &PRN) {
+    // Does no validation, make sure move is psuedo legal beforehand
+    uint8_t origin = moveUtils::getOrigin(move), target = moveUtils::getTarget(move);
+    uint8_t flag = moveUtils::getFlag(move);
+    char movingPiece = _board[origin];
+    bool isHalfMove = _board[target] == ' ';
+
+    UndoRecord &record = pushUndoRecord();
+    record.move = move;
+    record.movedPiece = movingPiece;
+    record.capturedPiece = _board[target];
+    record.capturedPos = target;
+
+    if (flag == MOVE_CASTLING) {
+        array<uint8_t, 2> rookMove = getCastlingRookMove(move);
+        char rook = _board[rookMove[0]];
+        togglePieceHash(PRN, rook, rookMove[0]);
+        togglePieceHash(PRN, rook, rookMove[1]);
+        removePiece(rookMove[0]);
+        putPiece(rookMove[1], rook);
     }
 
     if (enPassantSquare != INVALID_POS) {
         // Disable enPassant on last file
         this->zobristHash ^= PRN[prnEnPassantStart + enPassantSquare % 8];
     }
+    enPassantSquare = INVALID_POS;
 
-    if (tolower(_board[move[0]]) == 'p') {
-        if ((move[1] / 8 == 0 || move[1] / 8 == 7) && isComputer) {
-            if (player == WHITE) {
-                _board[move[0]] = 'Q';
-            } else {
-                _board[move[0]] = 'q';
-            }
-            changeZobristOnPromotion(PRN, 'q', move[1]);
-            isPromotion = true;
-        }
+    if (tolower(movingPiece) == 'p') {
         isHalfMove = false;
-        // En Passant
-        if (move[1] == enPassantSquare) {
-            uint8_t pos = enPassantSquare - getDirection(player) * 8;
-            _board[pos] = ' ';
-            // Remove piece from hash
-            this->zobristHash ^= PRN[getZobristStartIndex('p') + pos * player];
-        }
-        enPassantSquare = INVALID_POS;
-        if (abs(move[0] - move[1]) / 8 == 2) {
-            enPassantSquare = move[1] - getDirection(player) * 8;
+        if (flag == MOVE_PROMOTION) {
+            const char promotionNames[4] = {'n', 'b', 'r', 'q'};
+            char piece = promotionNames[moveUtils::getPromotionPiece(move) - KNIGHT];
+            movingPiece = player == WHITE ? toupper(piece) : piece;
+        } else if (flag == MOVE_EN_PASSANT) {
+            uint8_t pos = target - getDirection(player) * 8;
+            record.capturedPiece = _board[pos];
+            record.capturedPos = pos;
+            togglePieceHash(PRN, _board[pos], pos);
+            removePiece(pos);
+        } else if (abs(origin - target) == 16) {
+            enPassantSquare = target - getDirection(player) * 8;
             // Enable enPassant on file
             this->zobristHash ^= PRN[prnEnPassantStart + enPassantSquare % 8];
         }
-    } else {
-        enPassantSquare = INVALID_POS;
     }
 
-    if (tolower(_board[move[0]]) == 'r') {
-        if (move[0] == 0 && player == WHITE || move[0] == 56 && player == BLACK) {
-            disableQueenSideCastling(PRN);
-        } else if (move[0] == 7 && player == WHITE || move[0] == 63 && player == BLACK) {
-            disableKingSideCastling(PRN);
-        }
+    if (tolower(movingPiece) == 'k') {
+        disableCastling(PRN, player, 0);
+        disableCastling(PRN, player, 1);
     }
+    disableCastlingForSquare(PRN, origin);
+    disableCastlingForSquare(PRN, target);
 
-    if (isPromotion) {
-        // Remove pawn from board
-        this->zobristHash ^= PRN[getZobristStartIndex('p') + move[0] * player];
-    } else {
-        changeZobristOnMove(PRN, move);
+    if (_board[target] != ' ') {
+        togglePieceHash(PRN, _board[target], target);
     }
-    _board[move[1]] = _board[move[0]];
-    _board[move[0]] = ' ';
+    togglePieceHash(PRN, _board[origin], origin);
+    togglePieceHash(PRN, movingPiece, target);
+    removePiece(target);
+    removePiece(origin);
+    putPiece(target, movingPiece);
 
     if (player == BLACK) {
         fullMoves++;
@@ -674,36 +853,117 @@ void Board::makeMove(moveType move, prnType &PRN, bool isComputer, bool changeFE
         halfMoves = 0;
     }
 
-    if (changeFEN) {
-        fen = exportFEN();
+#ifdef VERIFY_ZOBRIST
+    // Debug only, doubles the hashing work of every move
+    if (zobristHash != computeZobristHash(PRN) || pawnHash != computePawnHash(PRN)) {
+        logging::e("ZobristError", "Incremental hash diverged after move " + moveUtils::toNotation(move));
+        assert(false);
     }
-    
-    unsigned long long prevHash = zobristHash;
-    calcZobristHash(PRN);
-    if (prevHash != zobristHash) {
-        logging::v("ZobristError", move[0]);
-        logging::v("ZobristError", move[1]);
-        logging::v("ZobristError", "FUCKED");
+#endif
+}
+
+void Board::unmakeMove() {
+    if (undoCount == 0) {
+        logging::e("UndoError", "No move to unmake");
+        return;
+    }
+    undoCount--;
+    UndoRecord &record = undoStack[undoCount & (MAX_UNDO_DEPTH - 1)];
+    moveType move = record.move;
+
+    player = !player;
+    if (player == BLACK) {
+        fullMoves--;
+    }
+
+    removePiece(moveUtils::getTarget(move));
+    putPiece(moveUtils::getOrigin(move), record.movedPiece);
+    if (record.capturedPiece != ' ') {
+        putPiece(record.capturedPos, record.capturedPiece);
+    }
+
+    if (moveUtils::getFlag(move) == MOVE_CASTLING) {
+        array<uint8_t, 2> rookMove = getCastlingRookMove(move);
+        putPiece(rookMove[0], _board[rookMove[1]]);
+        removePiece(rookMove[1]);
+    }
+
+    castlingRights[BLACK][0] = record.castlingRights[BLACK][0];
+    castlingRights[BLACK][1] = record.castlingRights[BLACK][1];
+    castlingRights[WHITE][0] = record.castlingRights[WHITE][0];
+    castlingRights[WHITE][1] = record.castlingRights[WHITE][1];
+    enPassantSquare = record.enPassantSquare;
+    halfMoves = record.halfMoves;
+    zobristHash = record.zobristHash;
+    pawnHash = record.pawnHash;
+}
+
+void Board::makeNullMove(prnType &PRN) {
+    // Pass the turn, used by null move pruning
+    UndoRecord &record = pushUndoRecord();
+    record.move = NULL_MOVE;
+
+    if (enPassantSquare != INVALID_POS) {
+        this->zobristHash ^= PRN[prnEnPassantStart + enPassantSquare % 8];
+        enPassantSquare = INVALID_POS;
+    }
+    player = !player;
+    this->zobristHash ^= PRN[prnBoardEnds];
+    halfMoves++;
+}
+
+void Board::unmakeNullMove() {
+    if (undoCount == 0) {
+        logging::e("UndoError", "No null move to unmake");
+        return;
+    }
+    undoCount--;
+    UndoRecord &record = undoStack[undoCount & (MAX_UNDO_DEPTH - 1)];
+
+    player = !player;
+    enPassantSquare = record.enPassantSquare;
+    halfMoves = record.halfMoves;
+    zobristHash = record.zobristHash;
+}
+
+moveType Board::createMove(uint8_t origin, uint8_t target, uint8_t promotionPiece) {
+    // Fill in the flags of a move given only by its squares
+    char piece = tolower(_board[origin]);
+    if (piece == 'k' && abs(origin - target) == 2) {
+        return moveUtils::create(origin, target, MOVE_CASTLING);
+    }
+    if (piece == 'p' && (target / 8 == 0 || target / 8 == 7)) {
+        return moveUtils::create(origin, target, MOVE_PROMOTION, promotionPiece);
+    }
+    if (piece == 'p' && target == enPassantSquare) {
+        return moveUtils::create(origin, target, MOVE_EN_PASSANT);
+    }
+    return moveUtils::create(origin, target);
+}
+
+moveType Board::parseMove(const string& move) {
+    // Move in chess notation, promotions default to a queen
+    uint8_t promotionPiece = QUEEN;
+    if (move.size() > 4) {
+        promotionPiece = getPieceType(move[4]);
     }
+    return createMove(parseNotation(move.substr(0, 2)), parseNotation(move.substr(2, 2)), promotionPiece);
 }
 
-void Board::makeMove(const string& move, prnType &PRN, bool isComputer, bool changeFEN) {
-    // Make move in chess notation
-    moveType moveRaw = {parseNotation(move.substr(0, 2)), parseNotation(move.substr(2, 2))};
-    makeMove(moveRaw, PRN, isComputer, changeFEN);
+void Board::makeMove(const string& move, prnType &PRN) {
+    makeMove(parseMove(move), PRN);
 }
 
 bool Board::makeMoveIfLegal(preCalculation::preCalcType preCalculatedData, moveType move) {
     if (isValidMove(move, preCalculatedData)) {
-        makeMove(move, preCalculatedData->PRN, true);
+        makeMove(move, preCalculatedData->PRN);
         return true;
     }
     return false;
 }
 
 bool Board::makeMoveIfLegal(preCalculation::preCalcType preCalculatedData, const string& move) {
-    moveType moveRaw = {parseNotation(move.substr(0, 2)), parseNotation(move.substr(2, 2))};
-    return makeMoveIfLegal(preCalculatedData, moveRaw);
+    return makeMoveIfLegal(preCalculatedData, parseMove(move));
 }
 
 bool Board::isInCheck(preCalculation::preCalcType &preCalc, playerType player) {
@@ -713,33 +973,13 @@ bool Board::isInCheck(preCalculation::preCalcType &preCalc, playerType player) {
         logging::e("KingError", "King not found");
         return false;
     }
-    return getAttackArea(preCalc, !player).test(kingPos);
-}
-
-bool Board::isValidMove(map<uint8_t, boardType> &moves, array<uint8_t, 2> move, preCalculation::preCalcType preCalculatedData) {
-    boardType availableMoves = moves[move[0]];
-
-    if (!availableMoves.test(move[1])) {
-        return false;
-    }
-
-    Board newBoard(*this);
-    newBoard.makeMove(move, preCalculatedData->PRN, false, false);
-
-    uint8_t kingPos = newBoard.findKing(this->player);
-    if (kingPos < 64) {
-        map<uint8_t, boardType> enemyMoves = newBoard.getNextMoves(preCalculatedData, newBoard.player, true);
-        for (auto itr = enemyMoves.begin(); itr != enemyMoves.end(); itr++) {
-            if (itr->second.test(kingPos)) {
-                return false;
-            }
-        }
-    }
-    return true;
+    return getAttackersOf(preCalc, kingPos, !player, getAllPieces()).any();
 }
 
-bool Board::isValidMove(array<uint8_t, 2> move, preCalculation::preCalcType preCalculatedData) {
-    map<uint8_t, boardType> nextMoves = this->getNextMoves(preCalculatedData, this->player, true);
-    return this->isValidMove(nextMoves, move, preCalculatedData);
+bool Board::isValidMove(moveType move, preCalculation::preCalcType preCalculatedData) {
+    // The generator only emits legal moves
+    MoveList moves;
+    getNextMoves(preCalculatedData, moves, this->player);
+    return moves.contains(move);
 }
 #endif
\ No newline at end of file
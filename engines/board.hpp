@@ -2,53 +2,104 @@
 #define CHESS_BOARD_H 1
 
 #include<string>
-#include<map>
-#include<vector>
+#include<array>
 
 #include "definitions.hpp"
+#include "moveList.hpp"
 #include "preCalculation.hpp"
 
 using std::string;
-using std::map;
-using std::vector;
+using std::array;
 
 class Board {
     private:
-        string fen;
+        // Everything makeMove can't recover on its own
+        struct UndoRecord {
+            moveType move;
+            char movedPiece;
+            char capturedPiece;
+            uint8_t capturedPos;
+            bool castlingRights[2][2];
+            uint8_t enPassantSquare;
+            uint8_t halfMoves;
+            unsigned long long zobristHash;
+            unsigned long long pawnHash;
+        };
+
         unsigned long long zobristHash;
+        // Pawns only, keys the pawn structure cache
+        unsigned long long pawnHash;
+        // Mailbox, kept in sync with the bitboards for O(1) pieceAt
         char _board[64];
+        // Bitboards, updated incrementally on every move
+        boardType pieceBoards[2][6]; // [color][pieceType]
+        boardType colorBoards[2]; // [color]
+        // Ring buffer of undo records, only the last MAX_UNDO_DEPTH moves can be unmade
+        array<UndoRecord, MAX_UNDO_DEPTH> undoStack;
+        uint32_t undoCount = 0;
 
         short int getDirection(playerType player);
 
-        boardType getPawnMoves(boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea = false);
+        void putPiece(uint8_t pos, char piece);
+
+        void removePiece(uint8_t pos);
+
+        UndoRecord& pushUndoRecord();
+
+        array<uint8_t, 2> getCastlingRookMove(moveType kingMove);
+
+        void addMoves(MoveList &moves, uint8_t origin, boardType targets);
 
-        boardType getKnightMoves(boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea = false);
+        void addPawnMoves(MoveList &moves, uint8_t origin, boardType targets);
 
-        boardType getKingMoves(boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea = false);
+        boardType getPawnMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea = false);
+
+        boardType getPawnAttacks(playerType player);
+
+        boardType getKnightMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea = false);
+
+        boardType getKingMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea = false);
 
         uint16_t getMagicHash(boardType &board, unsigned long long magic, boardType& blockerMask, bool isBishop);
 
-        boardType getBishopMoves(preCalculation::preCalcType data, boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea = false);
+        boardType getBishopMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea = false);
+
+        boardType getRookMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea = false);
+
+        boardType getQueenMoves(preCalculation::preCalcType &data, playerType player, uint8_t pos, bool isAttackArea = false);
 
-        boardType getRookMoves(preCalculation::preCalcType data, boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea = false);
+        boardType getBishopAttacks(preCalculation::preCalcType &data, uint8_t pos, boardType occupancy);
 
-        boardType getQueenMoves(preCalculation::preCalcType data, boardType &whitePieces, boardType &blackPieces, playerType player, uint8_t pos, bool isAttackArea = false);
+        boardType getRookAttacks(preCalculation::preCalcType &data, uint8_t pos, boardType occupancy);
 
-        boardType getCastlingMoves(preCalculation::preCalcType preCalculatedData, uint8_t kingPos, bool isLeftClear, bool isRightClear);
+        boardType getCastlingMoves(boardType enemyAttacks, uint8_t kingPos, bool isLeftClear, bool isRightClear);
 
-        void parseCastlingRights(int &index);
+        boardType getAttackersOf(preCalculation::preCalcType &data, uint8_t pos, playerType attacker, boardType occupancy);
 
-        uint16_t parseIntInFEN(int &index);
+        boardType getPinnedPieces(preCalculation::preCalcType &data, playerType player, uint8_t kingPos);
 
-        static unsigned short getZobristStartIndex(char piece);
+        bool isEnPassantLegal(preCalculation::preCalcType &data, uint8_t origin, uint8_t kingPos);
 
-        void changeZobristOnMove(prnType &PRN, moveType &move);
+        boardType getAttackArea(preCalculation::preCalcType &preCalculatedData, playerType player, boardType occupancy);
 
-        void disableQueenSideCastling(prnType &PRN);
+        uint8_t getCapturedPieceType(moveType move);
 
-        void disableKingSideCastling(prnType &PRN);
+        // Piece values of the static exchange evaluation, indexed by piece type
+        static constexpr int seeValues[7] = {50, 150, 200, 300, 500, 20000, 0};
 
-        void changeZobristOnPromotion(prnType &PRN, char piece, uint8_t pos);
+        void parseCastlingRights(const string &fen, int &index);
+
+        uint16_t parseIntInFEN(const string &fen, int &index);
+
+        static unsigned short getZobristIndex(char piece, uint8_t pos);
+
+        static unsigned short getCastlingZobristIndex(playerType color, uint8_t side, bool isAvailable);
+
+        void togglePieceHash(prnType &PRN, char piece, uint8_t pos);
+
+        void disableCastling(prnType &PRN, playerType color, uint8_t side);
+
+        void disableCastlingForSquare(prnType &PRN, uint8_t pos);
     public:
         uint8_t enPassantSquare;
         bool castlingRights[2][2]; // [color][side] Queen -> 0, King -> 1
@@ -56,63 +107,98 @@ class Board {
         uint8_t halfMoves;
         uint16_t fullMoves;
 
-        boardType getPiecesOfPlayer(playerType player);
+        boardType getPiecesOfPlayer(playerType player) {
+            return colorBoards[player];
+        }
+
+        boardType getPieces(playerType player, uint8_t pieceType) {
+            return pieceBoards[player][pieceType];
+        }
+
+        boardType getAllPieces() {
+            return colorBoards[WHITE] | colorBoards[BLACK];
+        }
 
         static uint8_t parseNotation(string notation);
 
         static string getNotation(int pos);
 
+        unsigned long long computeZobristHash(prnType &PRN);
+
         void calcZobristHash(prnType &PRN);
 
+        unsigned long long computePawnHash(prnType &PRN);
+
         unsigned long long getZobristHash() {
             return zobristHash;
         }
 
+        unsigned long long getPawnHash() {
+            return pawnHash;
+        }
+
         bool getCastlingRights(int color, int side) {
             return castlingRights[color][side];
         }
 
         string getFen() {
-            return fen;
+            // Built on demand, the board itself is the source of truth
+            return exportFEN();
         }
 
         static playerType getPlayer(char piece);
 
+        static uint8_t getPieceType(char piece);
+
         char pieceAt(uint8_t pos);
 
-        void parseFen();
+        void parseFen(const string &fen);
 
         Board(string _fen, prnType &PRN);
 
-        Board(const Board &original);
-        
         Board();
 
         bool isCapture(moveType move);
 
         bool isInCheck(preCalculation::preCalcType& preCalculatedData, playerType player);
 
-        map<uint8_t, boardType> getNextMoves(preCalculation::preCalcType preCalculatedData, playerType player, bool quick = false);
+        void getNextMoves(preCalculation::preCalcType &preCalculatedData, MoveList &moves, playerType player, uint8_t genType = GEN_ALL);
+
+        boardType getAttackArea(preCalculation::preCalcType &preCalculatedData, playerType player);
 
-        boardType getAttackArea(preCalculation::preCalcType preCalculatedData, playerType player);
+        void orderedNextMoves(preCalculation::preCalcType &preCalculatedData, MoveList &moves, playerType player);
 
-        vector<moveType> orderedNextMoves(preCalculation::preCalcType preCalculatedData, playerType player);
+        void orderCaptures(MoveList &moves);
+
+        int see(preCalculation::preCalcType &data, moveType move);
+
+        bool isLosingCapture(preCalculation::preCalcType &data, moveType move);
         
         uint8_t findKing(playerType player);
 
         string exportFEN();
 
-        void makeMove(array<uint8_t, 2> move, prnType &PRN, bool isComputer=false, bool changeFEN=true);
+        moveType createMove(uint8_t origin, uint8_t target, uint8_t promotionPiece = QUEEN);
+
+        moveType parseMove(const string& move);
+
+        unsigned long long getKeyAfterMove(moveType move, prnType &PRN);
+
+        void makeMove(moveType move, prnType &PRN);
 
-        void makeMove(const string& move, prnType &PRN, bool isComputer=false, bool changeFEN=true);
+        void makeMove(const string& move, prnType &PRN);
+
+        void unmakeMove();
+
+        void makeNullMove(prnType &PRN);
+
+        void unmakeNullMove();
 
         bool makeMoveIfLegal(preCalculation::preCalcType preCalculatedData, moveType move);
 
         bool makeMoveIfLegal(preCalculation::preCalcType preCalculatedData, const string& move);
 
-        bool isValidMove(map<uint8_t, boardType> &moves, array<uint8_t, 2> move, preCalculation::preCalcType preCalculatedData);
-
-        bool isValidMove(array<uint8_t, 2> move, preCalculation::preCalcType preCalculatedData);
+        bool isValidMove(moveType move, preCalculation::preCalcType preCalculatedData);
 };
 
 #endif
\ No newline at end of file
@@ -19,10 +19,12 @@ namespace client {
     struct serverInput {
         string fen;
         string gameId;
-        moveType move;
+        array<uint8_t, 2> move; // Origin and target squares
         uint8_t maxDepth;
         bool enableTT;
         bool enableAlphaBetaPruning;
+        bool enableBook;
+        string bookPath;
     };
 
     serverInput parseInput(int count, char **args) {
@@ -33,7 +35,10 @@ namespace client {
             {std::stoi(args[3]), std::stoi(args[4])},
             std::stoi(args[5]),
             std::stoi(args[6]),
-            std::stoi(args[7])
+            std::stoi(args[7]),
+            // Optional, the book is on by default
+            count > 8 ? std::stoi(args[8]) != 0 : true,
+            count > 9 ? args[9] : book::defaultBookFile
         };
     }
 
@@ -49,10 +54,17 @@ namespace client {
         client::serverInput data = client::parseInput(argc, argv);
         preCalculation::preCalcType preCalculatedData = preCalculation::load();
         ChessBot bot(data.gameId, preCalculatedData);
+        bot.setMaxDepth(data.maxDepth);
+        bot.setEnableAlphaBetaPruning(data.enableAlphaBetaPruning);
+        bot.setBookPath(data.bookPath);
+        bot.setEnableBook(data.enableBook);
+        // Loads the game's table snapshot from the previous move
+        bot.setEnableTT(data.enableTT);
 
         Board boardInstance(data.fen, preCalculatedData->PRN);
         array<string, 2> output;
-        if (boardInstance.makeMoveIfLegal(preCalculatedData, data.move)) {
+        moveType move = boardInstance.createMove(data.move[0], data.move[1]);
+        if (boardInstance.makeMoveIfLegal(preCalculatedData, move)) {
             bot.getNextMove(boardInstance);
             // moveType nextMove = bot.getLastCalculatedMove();
             output[0] = "OK";
@@ -63,8 +75,9 @@ namespace client {
         output[1] = boardInstance.getFen();
 
         std::cout << client::output(output);
-        stats::printStats();
         bot.dumpCache();
+        // The search printed its stats before the table was stored
+        stats::printTTTimes();
     }
 };
 
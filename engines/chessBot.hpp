@@ -7,6 +7,10 @@
 #include "board.cpp"
 #include "log.hpp"
 #include "transpositionTables.hpp"
+#include "pawnHash.hpp"
+#include "evalCache.hpp"
+#include "openingBook.hpp"
+#include "timeManagement.hpp"
 #include "statsutil.hpp"
 #include "utils.hpp"
 
@@ -17,36 +21,83 @@ class ChessBot {
         bool enableIterativeDeepening;
         bool enableQuiescenceSearch;
         bool enableNullMovePruning;
+        bool enableBook;
         float attackMultiplier;
         float defenceMultiplier;
         float spaceMultiplier;
         uint8_t maxDepth;
         uint8_t maxQuiescenceDepth;
-        array<bool, MAX_ALLOWED_DEPTH> depthTTFlags;
+        unsigned int hashSizeMB;
+        unsigned int threadCount;
+        // Lazy SMP helpers share the main bot's table and never report a move
+        bool isHelper = false;
+        // Kept across searches so their caches and history stay warm, rebuilt when the thread count changes
+        vector<std::unique_ptr<ChessBot>> helpers;
+        string ttFileName;
+        string bookPath;
+        // Read only once opened, shared by copies of the bot
+        std::shared_ptr<book::OpeningBook> openingBook;
+        // Quiet moves that caused a beta cutoff, 2 per ply
+        array<array<moveType, 2>, MAX_PLY> killerMoves;
+        // Butterfly history of quiet cutoffs [color][origin][target], halved before every search
+        array<array<array<uint32_t, 64>, 64>, 2> history;
         ttType transpositionTable;
+        PawnHashTable pawnHashTable;
+        EvalCache evalCache;
         preCalculation::preCalcType preCalcData;
-        bool isInterrupted;
+        // Written by other threads to stop the search, read with relaxed loads through getIsInterrupted
+        std::atomic<bool> isInterrupted;
+        // Limits of the next search, only the main thread reads the clock
+        timeManagement::TimeBudget timeBudget = timeManagement::unlimited;
+        std::chrono::steady_clock::time_point searchStartTime;
+        unsigned int nodesSinceTimeCheck = 0;
         struct LastCalculatedState {
             moveType move;
             long score;
         } lastCalculatedState;
 
-        void setTTAncientForDepth(uint8_t depth) {
-            if (!depthTTFlags[depth]) {
-                depthTTFlags[depth] = true;
-                transpositionTable->resetAge();
+        void resetLastCalculatedState() {
+            lastCalculatedState.move = NULL_MOVE;
+            lastCalculatedState.score = MIN_SCORE;
+        }
+
+        void resetMoveOrdering() {
+            for (auto &killers: killerMoves) {
+                killers = {NULL_MOVE, NULL_MOVE};
+            }
+            for (auto &colorHistory: history) {
+                for (auto &originHistory: colorHistory) {
+                    for (uint32_t &value: originHistory) {
+                        value /= 2;
+                    }
+                }
             }
         }
 
-        void resetLastCalculatedState() {
-            lastCalculatedState.move = {INVALID_POS, INVALID_POS};
-            lastCalculatedState.score = MIN_SCORE;
+        void orderQuietMoves(MoveList &moves, uint16_t quietStart, uint8_t ply, playerType player) {
+            // Promotions, then the killers of this ply, then by history
+            moves.sortByScore(quietStart, [&](moveType move) -> uint32_t {
+                if (moveUtils::getFlag(move) == MOVE_PROMOTION) {
+                    return UINT32_MAX;
+                }
+                if (move == killerMoves[ply][0]) {
+                    return UINT32_MAX - 1;
+                }
+                if (move == killerMoves[ply][1]) {
+                    return UINT32_MAX - 2;
+                }
+                return history[player][moveUtils::getOrigin(move)][moveUtils::getTarget(move)];
+            });
         }
 
-        void resetDepthTTFlags() {
-            for (int i=0; i < maxDepth; i++) {
-                depthTTFlags[i] = false;
+        void updateQuietCutoff(moveType move, uint8_t depth, uint8_t ply, playerType player) {
+            if (killerMoves[ply][0] != move) {
+                killerMoves[ply][1] = killerMoves[ply][0];
+                killerMoves[ply][0] = move;
             }
+            uint32_t &value = history[player][moveUtils::getOrigin(move)][moveUtils::getTarget(move)];
+            // Kept well below the killer scores
+            value = std::min(value + depth * depth, (uint32_t) UINT32_MAX / 2);
         }
 
         unsigned long getPieceScore(char piece) {
@@ -69,19 +120,24 @@ class ChessBot {
 
         long heuristic(Board &boardInstance) {
             stats::heruistic();
+            long score;
+            if (evalCache.probe(boardInstance.getZobristHash(), score)) {
+                return score;
+            }
+            score = evaluate(boardInstance);
+            evalCache.set(boardInstance.getZobristHash(), score);
+            return score;
+        }
+
+        long evaluate(Board &boardInstance) {
             long score = 0;
-            boardType playerPieces = boardType(0), enemyPieces = boardType(0);
-            for (int i=0; i < 64; i++) {
-                char piece = boardInstance.pieceAt(i);
-                if (piece == ' ')
-                    continue;
-                if (Board::getPlayer(piece) == boardInstance.player) {
-                    playerPieces.set(i);
-                    score += getPieceScore(piece);
-                } else {
-                    enemyPieces.set(i);
-                    score -= getPieceScore(piece);
-                }
+            boardType playerPieces = boardInstance.getPiecesOfPlayer(boardInstance.player);
+            boardType enemyPieces = boardInstance.getPiecesOfPlayer(!boardInstance.player);
+            const char pieces[6] = {'p', 'n', 'b', 'r', 'q', 'k'};
+            for (uint8_t pieceType=PAWN; pieceType <= KING; pieceType++) {
+                long count = (long) boardInstance.getPieces(boardInstance.player, pieceType).count()
+                    - (long) boardInstance.getPieces(!boardInstance.player, pieceType).count();
+                score += count * (long) getPieceScore(pieces[pieceType]);
             }
             boardType playerAttacks = boardInstance.getAttackArea(preCalcData, boardInstance.player);
             boardType enemyAttacks = boardInstance.getAttackArea(preCalcData, !boardInstance.player);
@@ -91,13 +147,33 @@ class ChessBot {
             score -= (enemyAttacks & playerPieces).count() * attackMultiplier;
 
             score += (playerAttacks & ~(playerPieces | enemyPieces)).count() * spaceMultiplier;
+
+            const PawnEntry &pawnEntry = pawnHashTable.probe(boardInstance);
+            score += boardInstance.player == WHITE ? pawnEntry.score : -pawnEntry.score;
             return score;
         }
 
+        long getElapsedMs() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - searchStartTime).count();
+        }
+
+        bool isTimeUp() {
+            // Stops the search at the hard limit, the clock is read every TIME_CHECK_NODES nodes
+            if (!timeBudget.isLimited() || ++nodesSinceTimeCheck < TIME_CHECK_NODES) {
+                return false;
+            }
+            nodesSinceTimeCheck = 0;
+            if (getElapsedMs() >= timeBudget.hardMs) {
+                isInterrupted = true;
+            }
+            return getIsInterrupted();
+        }
+
         long quiescenceSearch(Board &boardInstance, uint8_t depth, long alpha, long beta) {
-            if (isInterrupted) {
+            if (getIsInterrupted() || isTimeUp()) {
                 return INTERRUPTED_SCORE;
             }
+            stats::node();
             long score = heuristic(boardInstance);
             if (depth == 0 || !enableQuiescenceSearch) {
                 return score;
@@ -109,64 +185,66 @@ class ChessBot {
                 alpha = score;
             }
             stats::quiescenceSearch();
-            vector<moveType> moves = boardInstance.orderedNextMoves(preCalcData, boardInstance.player);
+            MoveList moves;
+            boardInstance.getNextMoves(preCalcData, moves, boardInstance.player, GEN_CAPTURES);
+            boardInstance.orderCaptures(moves);
             for (moveType move : moves) {
-                if (isInterrupted) {
+                if (getIsInterrupted()) {
                     return INTERRUPTED_SCORE;
                 }
-                if (boardInstance.isCapture(move)) {
-                    Board newBoard(boardInstance);
-                    newBoard.makeMove(move, preCalcData->PRN);
-                    score = -quiescenceSearch(newBoard, depth - 1, -beta, -alpha);
-                    if (std::abs(score) == INTERRUPTED_SCORE) {
-                        return INTERRUPTED_SCORE;
-                    }
-                    alpha = std::max(alpha, score);
-                    if (score >= beta) {
-                        return beta;
-                    }
+                if (boardInstance.isLosingCapture(preCalcData, move)) {
+                    // Loses material even if the opponent recaptures only while it pays off
+                    stats::seePrune();
+                    continue;
+                }
+                boardInstance.makeMove(move, preCalcData->PRN);
+                score = -quiescenceSearch(boardInstance, depth - 1, -beta, -alpha);
+                boardInstance.unmakeMove();
+                if (std::abs(score) == INTERRUPTED_SCORE) {
+                    return INTERRUPTED_SCORE;
+                }
+                alpha = std::max(alpha, score);
+                if (score >= beta) {
+                    return beta;
                 }
             }
             return alpha;
         }
 
-        long negaMax(Board &boardInstance, uint8_t depth, bool isNullMove = false, long alpha = MIN_SCORE, long beta = MAX_SCORE) {
-            if (isInterrupted) {
+        long negaMax(Board &boardInstance, uint8_t depth, uint8_t ply, bool isNullMove = false, long alpha = MIN_SCORE, long beta = MAX_SCORE) {
+            if (getIsInterrupted() || isTimeUp()) {
                 return INTERRUPTED_SCORE;
             }
-            setTTAncientForDepth(depth);
+            stats::node();
             long currentMax = MIN_SCORE;
             long oldAlpha = alpha;
-            moveType bestMove;
-            std::shared_ptr<HashEntry> ttEntry = transpositionTable->get(boardInstance.getZobristHash());
-            if (ttEntry != nullptr) {
-                if (ttEntry->depth == depth) {
-                    if (ttEntry->flag == TT_EXACT) {
+            moveType bestMove = NULL_MOVE;
+            HashEntry ttEntry;
+            moveType hashMove = NULL_MOVE;
+            if (transpositionTable->probe(boardInstance.getZobristHash(), ttEntry)) {
+                hashMove = ttEntry.bestMove;
+                if (ttEntry.depth == depth) {
+                    if (ttEntry.flag == TT_EXACT) {
                         // Exact
                         stats::hitTTExact();
-                        // TODO: Fix this
-                        // return ttEntry->score;
-                        // Board newBoard(boardInstance);
-                        // newBoard.makeMove(ttEntry->bestMove, preCalcData->PRN, true);
-                        // long score = -negaMax(newBoard, preCalcData, depth - 1, transpositionTable, -beta, -alpha);
-                        // if (score != ttEntry->score) {
-                        //     stats::ttExactInconsistent++;
-                        // }
-                    } else if (ttEntry->flag == TT_LB) {
+                        if (enableAlphaBetaPruning && beta - alpha == 1) {
+                            // Only in null windows, PV nodes search on so the line and its score stay intact
+                            stats::prune();
+                            return ttEntry.score;
+                        }
+                    } else if (ttEntry.flag == TT_LB) {
                         // Alpha cutoff
                         stats::hitTTAlpha();
-                        alpha = std::max(alpha, ttEntry->score);
-                    } else if (ttEntry->flag == TT_UB) {
+                        alpha = std::max(alpha, (long) ttEntry.score);
+                    } else if (ttEntry.flag == TT_UB) {
                         // Beta cutoff
                         stats::hitTTBeta();
-                        beta = std::min(beta, ttEntry->score);
+                        beta = std::min(beta, (long) ttEntry.score);
                     }
                     if (enableAlphaBetaPruning && beta <= alpha) {
                         stats::prune();
-                        return ttEntry->score;
+                        return ttEntry.score;
                     }
-                } else {
-
                 }
             }
             if (depth == 0) {
@@ -178,9 +256,9 @@ class ChessBot {
             }
             if (enableNullMovePruning && !isNullMove && !boardInstance.isInCheck(preCalcData, boardInstance.player)) {
                 // Try a null move
-                Board newBoard(boardInstance);
-                newBoard.player = !newBoard.player;
-                long score = -negaMax(newBoard, depth - 1, true, -beta, -beta + 1);
+                boardInstance.makeNullMove(preCalcData->PRN);
+                long score = -negaMax(boardInstance, depth - 1, ply + 1, true, -beta, -beta + 1);
+                boardInstance.unmakeNullMove();
                 if (std::abs(score) == INTERRUPTED_SCORE) {
                     return INTERRUPTED_SCORE;
                 }
@@ -190,38 +268,61 @@ class ChessBot {
                 }
                 stats::nullMoveNotPrune();
             }
-            vector<moveType> nextMoves = boardInstance.orderedNextMoves(preCalcData, boardInstance.player);
-            for (auto currentMove = nextMoves.begin();!isInterrupted && currentMove != nextMoves.end(); currentMove++) {
+            MoveList nextMoves, captures, losingCaptures;
+            // Captures that don't lose material by MVV-LVA, the quiet moves by killers and history, then losing captures
+            boardInstance.getNextMoves(preCalcData, captures, boardInstance.player, GEN_CAPTURES);
+            boardInstance.orderCaptures(captures);
+            for (moveType move: captures) {
+                if (boardInstance.isLosingCapture(preCalcData, move)) {
+                    losingCaptures.push(move);
+                } else {
+                    nextMoves.push(move);
+                }
+            }
+            uint16_t quietStart = nextMoves.size();
+            boardInstance.getNextMoves(preCalcData, nextMoves, boardInstance.player, GEN_QUIETS);
+            orderQuietMoves(nextMoves, quietStart, ply, boardInstance.player);
+            for (moveType move: losingCaptures) {
+                nextMoves.push(move);
+            }
+            if (nextMoves.empty()) {
+                // Checkmate or stalemate
+                return boardInstance.isInCheck(preCalcData, boardInstance.player) ? MIN_SCORE : 0;
+            }
+            if (hashMove != NULL_MOVE) {
+                // Best move of an earlier search first, it's only trusted if it's legal here
+                nextMoves.moveToFront(hashMove);
+            }
+            for (auto currentMove = nextMoves.begin();!getIsInterrupted() && currentMove != nextMoves.end(); currentMove++) {
                 long score;
-                moveType move = *currentMove;
-                if (tolower(boardInstance.pieceAt(move[1])) == 'k') {
-                    // King capture is illegal, prune
-                    stats::illegalKingCapture();
-                    return MAX_SCORE;
+#ifndef NO_TT_PREFETCH
+                if (enableTT) {
+                    // The child's bucket loads while the move is made
+                    transpositionTable->prefetch(boardInstance.getKeyAfterMove(*currentMove, preCalcData->PRN));
                 }
-                Board newBoard(boardInstance);
-                newBoard.makeMove(*currentMove, preCalcData->PRN, true);
+#endif
+                bool isQuiet = !boardInstance.isCapture(*currentMove) && moveUtils::getFlag(*currentMove) != MOVE_PROMOTION;
+                boardInstance.makeMove(*currentMove, preCalcData->PRN);
                 if (currentMove != nextMoves.begin()) {
                     // Perform a null window search
-                    score = -negaMax(newBoard, depth - 1, isNullMove, -alpha - 1, -alpha);
+                    score = -negaMax(boardInstance, depth - 1, ply + 1, isNullMove, -alpha - 1, -alpha);
                     if (std::abs(score) == INTERRUPTED_SCORE) {
+                        boardInstance.unmakeMove();
                         return INTERRUPTED_SCORE;
                     }
                     if (score > alpha && score < beta) {
                         // Perform a full search
                         stats::pvZWSFail();
-                        score = -negaMax(newBoard, depth - 1, isNullMove, -beta, -alpha);
-                        if (std::abs(score) == INTERRUPTED_SCORE) {
-                            return INTERRUPTED_SCORE;
-                        }
+                        score = -negaMax(boardInstance, depth - 1, ply + 1, isNullMove, -beta, -alpha);
                     } else {
                         stats::pvZWSSuccess();
                     }
                 } else {
-                    score = -negaMax(newBoard, depth - 1, isNullMove, -beta, -alpha);
-                    if (std::abs(score) == INTERRUPTED_SCORE) {
-                        return INTERRUPTED_SCORE;
-                    }
+                    score = -negaMax(boardInstance, depth - 1, ply + 1, isNullMove, -beta, -alpha);
+                }
+                boardInstance.unmakeMove();
+                if (std::abs(score) == INTERRUPTED_SCORE) {
+                    return INTERRUPTED_SCORE;
                 }
                 if (currentMax < score) {
                     currentMax = score;
@@ -229,6 +330,10 @@ class ChessBot {
                     bestMove = *currentMove;
                     if (enableAlphaBetaPruning && beta <= currentMax) {
                         stats::prune();
+                        stats::cutoff(currentMove == nextMoves.begin());
+                        if (isQuiet) {
+                            updateQuietCutoff(*currentMove, depth, ply, boardInstance.player);
+                        }
                         break;
                     }
                 }
@@ -244,60 +349,211 @@ class ChessBot {
             return currentMax;
         }
 
+        void searchRoot(Board &boardInstance, MoveList &nextMoves, uint8_t depthOffset) {
+            // Iterative deepening over the root moves, helpers start depthOffset plies deeper
+            vector<std::pair<moveType, long>> moveScoreMap;
+            for (const auto &move: nextMoves) {
+                moveScoreMap.push_back({move, MIN_SCORE});
+            }
+            long currentMax = MIN_SCORE;
+            // A timed search always deepens iteratively from a single ply, so short clocks still finish an iteration
+            uint8_t currentDepth = maxDepth - 1;
+            if (timeBudget.isLimited()) {
+                currentDepth = 0;
+            } else if (enableIterativeDeepening) {
+                currentDepth = std::min(3, maxDepth - 1);
+            }
+            currentDepth = std::min(currentDepth + depthOffset, maxDepth - 1);
+            moveType previousBestMove = NULL_MOVE;
+            uint8_t stableIterations = 0;
+            // Scores by the parity of the depth, the evaluation favours the side to move so odd and even depths differ
+            long parityScores[2] = {MIN_SCORE, MIN_SCORE};
+            bool hasParityScore[2] = {false, false};
+            for (; !getIsInterrupted() && currentDepth < maxDepth; currentDepth++) {
+                long iterationStartMs = getElapsedMs();
+                // Aspiration window around the score of two iterations ago, widened on every fail until it's the full window
+                long windowDelta = ASPIRATION_WINDOW;
+                long windowAlpha = MIN_SCORE, windowBeta = MAX_SCORE;
+#ifndef NO_ASPIRATION
+                if (enableAlphaBetaPruning && hasParityScore[currentDepth % 2]) {
+                    windowAlpha = std::max(parityScores[currentDepth % 2] - windowDelta, (long) MIN_SCORE);
+                    windowBeta = std::min(parityScores[currentDepth % 2] + windowDelta, (long) MAX_SCORE);
+                }
+#endif
+                while (!getIsInterrupted()) {
+                    long alpha = windowAlpha;
+                    long iterationMax = MIN_SCORE;
+                    auto bestPair = moveScoreMap.begin();
+                    for (auto currentPair = moveScoreMap.begin();!getIsInterrupted() && currentPair != moveScoreMap.end(); currentPair++) {
+                        moveType currentMove = currentPair->first;
+                        boardInstance.makeMove(currentMove, preCalcData->PRN);
+                        long score = enableAlphaBetaPruning ? -negaMax(boardInstance, currentDepth, 1, false, -windowBeta, -alpha)
+                            : -negaMax(boardInstance, currentDepth, 1);
+                        boardInstance.unmakeMove();
+                        if (std::abs(score) == INTERRUPTED_SCORE) {
+                            break;
+                        }
+                        // Scores at or below alpha are only upper bounds, they can't replace the best move
+                        if (score > iterationMax && score > alpha) {
+                            setLastCalculatedState(currentMove, score);
+                        }
+                        if (score > iterationMax) {
+                            iterationMax = score;
+                            bestPair = currentPair;
+                        }
+                        // Only this iteration's bound or score, a deeper search can refute an earlier fail high
+                        currentPair->second = score;
+                        if (enableAlphaBetaPruning) {
+                            alpha = std::max(alpha, score);
+                            if (score >= windowBeta) {
+                                break;
+                            }
+                        }
+                    }
+                    if (getIsInterrupted()) {
+                        break;
+                    }
+                    currentMax = iterationMax;
+                    if (iterationMax <= windowAlpha && windowAlpha > MIN_SCORE) {
+                        stats::aspirationFailLow();
+                        windowDelta *= 2;
+                        windowAlpha = std::max(windowAlpha - windowDelta, (long) MIN_SCORE);
+                    } else if (iterationMax >= windowBeta && windowBeta < MAX_SCORE) {
+                        stats::aspirationFailHigh();
+                        windowDelta *= 2;
+                        windowBeta = std::min(windowBeta + windowDelta, (long) MAX_SCORE);
+                        // The move that failed high is searched first, so it stays the best move if time runs out
+                        std::rotate(moveScoreMap.begin(), bestPair, bestPair + 1);
+                    } else {
+                        parityScores[currentDepth % 2] = iterationMax;
+                        hasParityScore[currentDepth % 2] = true;
+                        break;
+                    }
+                }
+                if (!isHelper) {
+                    logging::d("ChessBot", "Best move score: " + std::to_string(currentMax) + " with depth: " + std::to_string(currentDepth));
+                }
+                std::sort(moveScoreMap.begin(), moveScoreMap.end(), cmpForMovePair);
+
+                if (!isHelper && timeBudget.isLimited() && !getIsInterrupted()) {
+                    stableIterations = getLastCalculatedMove() == previousBestMove ? stableIterations + 1 : 0;
+                    previousBestMove = getLastCalculatedMove();
+                    long elapsedMs = getElapsedMs();
+                    // The next iteration takes at least as long as this one, a bit more than that is expected
+                    long nextIterationEndMs = elapsedMs + (elapsedMs - iterationStartMs) * 2;
+                    long softMs = timeBudget.softMs;
+                    if (timeBudget.isAdaptive) {
+                        softMs = std::min((long) (softMs * timeManagement::getStabilityScale(stableIterations)), timeBudget.hardMs);
+                    }
+                    if (nextIterationEndMs > softMs) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        void prepareHelper(ChessBot &helper) {
+            // Settings can change between searches, the caches are only cleared if the evaluation changed
+            helper.enableAlphaBetaPruning = enableAlphaBetaPruning;
+            helper.enableIterativeDeepening = enableIterativeDeepening;
+            helper.enableQuiescenceSearch = enableQuiescenceSearch;
+            helper.enableNullMovePruning = enableNullMovePruning;
+            helper.enableTT = enableTT;
+            helper.transpositionTable = transpositionTable;
+            if (helper.attackMultiplier != attackMultiplier) {
+                helper.setAttackMultiplier(attackMultiplier);
+            }
+            if (helper.defenceMultiplier != defenceMultiplier) {
+                helper.setDefenceMultiplier(defenceMultiplier);
+            }
+            if (helper.spaceMultiplier != spaceMultiplier) {
+                helper.setSpaceMultiplier(spaceMultiplier);
+            }
+            helper.maxDepth = maxDepth;
+            helper.maxQuiescenceDepth = maxQuiescenceDepth;
+            helper.resetLastCalculatedState();
+            helper.resetMoveOrdering();
+            helper.isInterrupted = false;
+        }
+
+        void searchWithHelpers(Board &boardInstance, MoveList &nextMoves) {
+            // Lazy SMP, helpers search the same root on their own boards and share results only through the TT.
+            // The main thread's move is played, the helpers stop once it's done
+            if (helpers.size() != threadCount - 1) {
+                helpers.clear();
+                for (unsigned int i=0; i < threadCount - 1; i++) {
+                    helpers.push_back(std::make_unique<ChessBot>(ttFileName, preCalcData));
+                    helpers.back()->isHelper = true;
+                }
+            }
+            vector<stats::Counters> helperStats(threadCount - 1);
+            vector<std::thread> helperThreads;
+            for (unsigned int i=0; i < threadCount - 1; i++) {
+                ChessBot &helper = *helpers[i];
+                prepareHelper(helper);
+                helperThreads.emplace_back([&helper, &nextMoves, &helperCounters = helperStats[i], boardInstance, i]() mutable {
+                    // Every other helper starts a ply deeper so the threads spread over depths
+                    helper.searchRoot(boardInstance, nextMoves, (i + 1) % 2);
+                    helperCounters = stats::counters;
+                });
+            }
+            searchRoot(boardInstance, nextMoves, 0);
+            for (auto &helper: helpers) {
+                helper->isInterrupted = true;
+            }
+            for (unsigned int i=0; i < helperThreads.size(); i++) {
+                helperThreads[i].join();
+                stats::counters += helperStats[i];
+                // Handed again before the next search, a replaced table isn't kept alive in between
+                helpers[i]->transpositionTable = nullptr;
+            }
+        }
+
         static bool cmpForMovePair(std::pair<moveType, long> a, std::pair<moveType, long> b) {
             return a.second > b.second;
         }
         
     public:
         void getNextMove(Board &boardInstance) {
+            searchStartTime = std::chrono::steady_clock::now();
+            nodesSinceTimeCheck = 0;
             stats::reset();
             resetLastCalculatedState();
             isInterrupted = false;
-            resetDepthTTFlags();
-            vector<moveType> nextMoves = boardInstance.orderedNextMoves(preCalcData, boardInstance.player);
-            if (nextMoves.size() == 0) {
+            resetMoveOrdering();
+            moveType bookMove = getBookMove(boardInstance);
+            if (bookMove != NULL_MOVE) {
+                logging::d("ChessBot", "Book move: " + moveUtils::toNotation(bookMove));
+                setLastCalculatedState(bookMove, 0);
+                boardInstance.makeMove(bookMove, preCalcData->PRN);
                 return;
             }
-            vector<std::pair<moveType, long>> moveScoreMap;
-            for (const auto &move: nextMoves) {
-                moveScoreMap.push_back({move, MIN_SCORE});
+            MoveList nextMoves;
+            boardInstance.orderedNextMoves(preCalcData, nextMoves, boardInstance.player);
+            if (nextMoves.empty()) {
+                return;
             }
-            long currentMax = MIN_SCORE;
-            uint8_t currentDepth = enableIterativeDeepening ? std::min(3, maxDepth - 1) : maxDepth - 1;
-            for (; !isInterrupted && currentDepth < maxDepth; currentDepth++) {
-                for (auto currentPair = moveScoreMap.begin();!isInterrupted && currentPair != moveScoreMap.end(); currentPair++) {
-                    moveType currentMove = currentPair->first;
-                    if (tolower(boardInstance.pieceAt(currentMove[1])) == 'k') {
-                        // King capture is illegal, TODO handle this    
-                    }
-                    Board newBoard(boardInstance);
-                    newBoard.makeMove(currentMove, preCalcData->PRN, true);
-                    long score = -negaMax(newBoard, currentDepth);
-                    if (std::abs(score) == INTERRUPTED_SCORE) {
-                        break;
-                    }
-                    if (score > currentMax || currentMax == MIN_SCORE) {
-                        setLastCalculatedState(currentMove, score);
-                        currentMax = score;
-                    }
-                    currentPair->second = std::max(currentPair->second, score);
-                }
-                logging::d("ChessBot", "Best move score: " + std::to_string(currentMax) + " with depth: " + std::to_string(currentDepth));
-                std::sort(moveScoreMap.begin(), moveScoreMap.end(), cmpForMovePair);
+            // Played if the search is stopped before the first root move is done
+            setLastCalculatedState(nextMoves[0], MIN_SCORE);
+            // Entries of earlier searches become replaceable, helpers never age the table
+            transpositionTable->nextGeneration();
+            if (threadCount <= 1 || !enableTT) {
+                searchRoot(boardInstance, nextMoves, 0);
+            } else {
+                searchWithHelpers(boardInstance, nextMoves);
             }
+            stats::printStats();
             boardInstance.makeMove(getLastCalculatedMove(), preCalcData->PRN);
-            if (boardInstance.isInCheck(preCalcData, !boardInstance.player)) {
-                resetLastCalculatedState();
-            }
-            logging::d("ChessBot", "Best move score: " + std::to_string(currentMax) + " with depth: " + std::to_string(currentDepth));
         }
 
-        void interrupt(bool isUCIMode=false) {
+        void interrupt() {
+            // Helpers are stopped by the search thread once it returns
             isInterrupted = true;
-            stats::printStats();
-            if (isUCIMode) {
-                std::cout << "bestmove " << getLastCalculatedMoveAsNotation() << std::endl;
-            }
+        }
+
+        void setTimeBudget(timeManagement::TimeBudget budget) {
+            // Used by every following search, unlimited by default
+            timeBudget = budget;
         }
 
         ChessBot(const ChessBot& otherChessBot) {
@@ -306,19 +562,27 @@ class ChessBot {
             enableTT = otherChessBot.enableTT;
             enableNullMovePruning = otherChessBot.enableNullMovePruning;
             enableQuiescenceSearch = otherChessBot.enableQuiescenceSearch;
+            enableBook = otherChessBot.enableBook;
+            bookPath = otherChessBot.bookPath;
+            openingBook = otherChessBot.openingBook;
             attackMultiplier = otherChessBot.attackMultiplier;
             defenceMultiplier = otherChessBot.defenceMultiplier;
             spaceMultiplier = otherChessBot.spaceMultiplier;
             maxDepth = otherChessBot.maxDepth;
             maxQuiescenceDepth = otherChessBot.maxQuiescenceDepth;
+            hashSizeMB = otherChessBot.hashSizeMB;
+            threadCount = otherChessBot.threadCount;
+            ttFileName = randomUtils::getHashFileName();
             isInterrupted = false;
             resetLastCalculatedState();
+            killerMoves = {};
+            history = {};
             if (enableTT) {
-                this->transpositionTable = std::make_unique<TranspositionTable>(randomUtils::getHashFileName());
+                this->transpositionTable = std::make_unique<TranspositionTable>(ttFileName, hashSizeMB);
             } else {
                 this->transpositionTable = std::make_unique<TranspositionTable>();
             }
-            this->preCalcData = preCalcData;
+            this->preCalcData = otherChessBot.preCalcData;
         }
 
         ChessBot() {
@@ -331,15 +595,23 @@ class ChessBot {
             enableTT = false;
             enableNullMovePruning = false;
             enableQuiescenceSearch = false;
+            enableBook = false;
+            bookPath = book::defaultBookFile;
+            openingBook = std::make_shared<book::OpeningBook>();
             attackMultiplier = 20;
             defenceMultiplier = 16;
             spaceMultiplier = 8;
             maxDepth = 6;
             maxQuiescenceDepth = 3;
+            hashSizeMB = DEFAULT_HASH_MB;
+            threadCount = DEFAULT_THREADS;
+            this->ttFileName = ttFileName;
             isInterrupted = false;
             resetLastCalculatedState();
+            killerMoves = {};
+            history = {};
             if (enableTT) {
-                this->transpositionTable = std::make_unique<TranspositionTable>(ttFileName);
+                this->transpositionTable = std::make_unique<TranspositionTable>(ttFileName, hashSizeMB);
             } else {
                 this->transpositionTable = std::make_unique<TranspositionTable>();
             }
@@ -348,6 +620,12 @@ class ChessBot {
 
         void newGame() {
             transpositionTable->clear();
+            pawnHashTable.clear();
+            evalCache.clear();
+            for (auto &helper: helpers) {
+                helper->pawnHashTable.clear();
+                helper->evalCache.clear();
+            }
         }
 
         void dumpCache() {
@@ -373,10 +651,46 @@ class ChessBot {
             if (isChanged && !enable) {
                 transpositionTable = std::make_unique<TranspositionTable>();
             } else if (isChanged && enable) {
-                transpositionTable = std::make_unique<TranspositionTable>("random");
+                transpositionTable = std::make_unique<TranspositionTable>(ttFileName, hashSizeMB);
             }
         }
 
+        void setHashSize(unsigned int sizeMB) {
+            // Clears the table
+            hashSizeMB = sizeMB;
+            if (enableTT) {
+                transpositionTable->resize(sizeMB);
+            }
+        }
+
+        void setEnableBook(bool enable) {
+            enableBook = enable;
+            if (enable && !openingBook->isOpen()) {
+                openingBook->open(bookPath);
+            }
+        }
+
+        void setBookPath(const string &path) {
+            bookPath = path;
+            openingBook = std::make_shared<book::OpeningBook>();
+            if (enableBook) {
+                openingBook->open(bookPath);
+            }
+        }
+
+        moveType getBookMove(Board &boardInstance) {
+            // NULL_MOVE if the book is off or doesn't know the position
+            if (!enableBook) {
+                return NULL_MOVE;
+            }
+            return openingBook->probe(boardInstance, preCalcData);
+        }
+
+        void setThreads(unsigned int count) {
+            // Helpers only run with the TT enabled, it's the only thing they share
+            threadCount = count;
+        }
+
         void setEnableNullMovePruning(bool enable) {
             enableNullMovePruning = enable;
         }
@@ -387,14 +701,17 @@ class ChessBot {
 
         void setAttackMultiplier(float val) {
             attackMultiplier = val;
+            evalCache.clear();
         }
 
         void setDefenceMultiplier(float val) {
             defenceMultiplier = val;
+            evalCache.clear();
         }
 
         void setSpaceMultiplier(float val) {
             spaceMultiplier = val;
+            evalCache.clear();
         }
 
         void setMaxDepth(uint8_t depth) {
@@ -406,7 +723,7 @@ class ChessBot {
         }
 
         bool getIsInterrupted() {
-            return isInterrupted;
+            return isInterrupted.load(std::memory_order_relaxed);
         }
 
         LastCalculatedState getLastCalculatedState() {
@@ -418,12 +735,12 @@ class ChessBot {
         }
 
         string getLastCalculatedMoveAsNotation() {
-            if (lastCalculatedState.move[0] == INVALID_POS) {
+            if (lastCalculatedState.move == NULL_MOVE) {
                 // Lost
                 logging::d("Game", "Lost");
                 return "(none)";
             }
-            return Board::getNotation(lastCalculatedState.move[0]) + Board::getNotation(lastCalculatedState.move[1]);
+            return moveUtils::toNotation(lastCalculatedState.move);
         }
 
         bool getEnableAlphaBetaPruning() {
@@ -438,6 +755,10 @@ class ChessBot {
             return enableTT;
         }
 
+        bool getEnableBook() {
+            return enableBook;
+        }
+
         bool getEnableNullMovePruning() {
             return enableNullMovePruning;
         }
@@ -1,2 +1,10 @@
 #/bin/sh
-g++ -pthread -std=c++20 /app/engines/chess.cpp -o /app/engines/chess.out
+# Magic sliding attacks, run with USE_PEXT=1 to build PEXT ones for BMI2 CPUs instead
+FLAGS=""
+if [ "$USE_PEXT" = "1" ]; then
+    FLAGS="-mbmi2 -DUSE_PEXT"
+fi
+g++ -pthread -std=c++20 $FLAGS /app/engines/chess.cpp -o /app/engines/chess.out
+# Binary precalc data, its layout follows the compiler so it is generated here
+g++ -std=c++20 /app/engines/convertPreCalc.cpp -o /app/engines/convertPreCalc.out
+/app/engines/convertPreCalc.out
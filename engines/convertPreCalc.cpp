@@ -0,0 +1,16 @@
+#include <iostream>
+
+#include "preCalculation.hpp"
+
+int main(int argc, char **argv) {
+    // convertPreCalc.out [output]
+    // Converts the text precalc file to the binary format mapped by preCalculation::load
+    string output = argc > 1 ? argv[1] : preCalculation::binaryFile;
+    preCalculation::preCalcType data = preCalculation::loadText();
+    if (!preCalculation::writeBinary(output, *data)) {
+        std::cout << "Could not write " << output << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << output << std::endl;
+    return 0;
+}
@@ -4,19 +4,79 @@
 #include<bitset>
 #include<array>
 
-#define MAX_SCORE 9999999
+// Scores fit in 16 bits so the transposition table can store them packed
+#define MAX_SCORE 32000
 #define INTERRUPTED_SCORE 99999990
-#define MIN_SCORE -9999999
+#define MIN_SCORE -32000
 #define BLACK 0
 #define WHITE 1
 #define INVALID_POS 64
-#define CACHE_SIZE 100000
+// Transposition table size in MB, rounded down to a power of 2
+#define DEFAULT_HASH_MB 16
+#define MIN_HASH_MB 1
+#define MAX_HASH_MB 1024
+#define CACHE_LINE_SIZE 64
+// Lock stripes of the shared transposition table, must be a power of 2
+#define TT_LOCK_COUNT 1024
+// Depth a TT entry loses per search it has aged, when picking the entry to replace
+#define TT_AGE_WEIGHT 8
+// Search threads, the main one included
+#define DEFAULT_THREADS 1
+#define MIN_THREADS 1
+#define MAX_THREADS 64
+// Time management, in ms unless noted
+#define MOVE_OVERHEAD_MS 30
+#define DEFAULT_MOVES_TO_GO 30
+// Hard budget in multiples of the per move share of the clock
+#define HARD_TIME_FACTOR 3
+// Nodes searched between two clock reads
+#define TIME_CHECK_NODES 1024
+// Pawn structure cache entries per search thread, must be a power of 2
+#define PAWN_HASH_ENTRIES 16384
+// Static evaluation cache entries per search thread, must be a power of 2
+#define EVAL_CACHE_ENTRIES 65536
+// Half width of the first root search window around the last iteration's score
+#define ASPIRATION_WINDOW 25
 #define MAX_ALLOWED_DEPTH 10
 #define MIN_ALLOWED_DEPTH 1
+// Plies from the root a search can reach, bounds the per ply tables of ChessBot
+#define MAX_PLY 64
+// Undo records kept by Board, must be a power of 2
+#define MAX_UNDO_DEPTH 256
+
+// Piece types, used to index the per piece bitboards of Board
+#define PAWN 0
+#define KNIGHT 1
+#define BISHOP 2
+#define ROOK 3
+#define QUEEN 4
+#define KING 5
+#define NO_PIECE 6
+
+// Move flags, stored in the top 2 bits of moveType
+#define MOVE_NORMAL 0
+#define MOVE_PROMOTION 1
+#define MOVE_EN_PASSANT 2
+#define MOVE_CASTLING 3
+// Never a valid move, origin and target are the same square
+#define NULL_MOVE 0
+// No position has more legal moves than this
+#define MAX_MOVES 256
+
+// Kinds of moves generated by Board::getNextMoves
+#define GEN_ALL 0
+#define GEN_CAPTURES 1
+#define GEN_QUIETS 2
 
 typedef std::bitset<64> boardType;
 typedef uint8_t playerType;
-typedef std::array<uint8_t, 2> moveType;
+/*
+Packed move
+
+Bits 0-5 origin, bits 6-11 target, bits 12-13 promotion piece(KNIGHT to QUEEN, offset by KNIGHT)
+and bits 14-15 the move flag
+*/
+typedef uint16_t moveType;
 
 /*
 Random Num Array
@@ -0,0 +1,44 @@
+#ifndef CHESS_EVAL_CACHE_H
+#define CHESS_EVAL_CACHE_H 1
+#include <vector>
+
+#include "definitions.hpp"
+#include "statsutil.hpp"
+
+struct EvalEntry {
+    unsigned long long zobristHash;
+    long score; // Side to move's point of view
+};
+
+class EvalCache {
+    // Direct mapped cache of static evaluations, owned by a single search thread.
+    // Has to be cleared whenever the evaluation weights change
+    private:
+        std::vector<EvalEntry> entries;
+    public:
+        EvalCache() {
+            entries = std::vector<EvalEntry>(EVAL_CACHE_ENTRIES, EvalEntry{0, 0});
+        }
+
+        bool probe(unsigned long long zobristHash, long &score) {
+            // Hash 0 marks an empty entry, a real position hashing to 0 is only ever a miss
+            EvalEntry &entry = entries[zobristHash & (EVAL_CACHE_ENTRIES - 1)];
+            if (zobristHash != 0 && entry.zobristHash == zobristHash) {
+                stats::hitEvalCache();
+                score = entry.score;
+                return true;
+            }
+            stats::missEvalCache();
+            return false;
+        }
+
+        void set(unsigned long long zobristHash, long score) {
+            entries[zobristHash & (EVAL_CACHE_ENTRIES - 1)] = {zobristHash, score};
+        }
+
+        void clear() {
+            std::fill(entries.begin(), entries.end(), EvalEntry{0, 0});
+        }
+};
+
+#endif
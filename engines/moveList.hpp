@@ -0,0 +1,126 @@
+#ifndef CHESS_MOVELIST_H
+#define CHESS_MOVELIST_H 1
+
+#include<string>
+#include<array>
+#include<algorithm>
+
+#include "definitions.hpp"
+
+using std::string;
+using std::array;
+
+namespace moveUtils {
+    inline moveType create(uint8_t origin, uint8_t target, uint8_t flag = MOVE_NORMAL, uint8_t promotionPiece = KNIGHT) {
+        return origin | (target << 6) | ((promotionPiece - KNIGHT) << 12) | (flag << 14);
+    }
+
+    inline uint8_t getOrigin(moveType move) {
+        return move & 0x3f;
+    }
+
+    inline uint8_t getTarget(moveType move) {
+        return (move >> 6) & 0x3f;
+    }
+
+    inline uint8_t getFlag(moveType move) {
+        return move >> 14;
+    }
+
+    inline uint8_t getPromotionPiece(moveType move) {
+        // Only meaningful when the flag is MOVE_PROMOTION
+        return ((move >> 12) & 0x3) + KNIGHT;
+    }
+
+    string toNotation(moveType move) {
+        const char promotionNames[4] = {'n', 'b', 'r', 'q'};
+        string out;
+        uint8_t origin = getOrigin(move), target = getTarget(move);
+        out.push_back(origin % 8 + 'a');
+        out.push_back((7 - origin / 8) + '1');
+        out.push_back(target % 8 + 'a');
+        out.push_back((7 - target / 8) + '1');
+        if (getFlag(move) == MOVE_PROMOTION) {
+            out.push_back(promotionNames[getPromotionPiece(move) - KNIGHT]);
+        }
+        return out;
+    }
+}
+
+class MoveList {
+    // Fixed capacity, lives on the stack so generating moves never allocates
+    private:
+        array<moveType, MAX_MOVES> moves;
+        uint16_t count = 0;
+    public:
+        void push(moveType move) {
+            moves[count++] = move;
+        }
+
+        void clear() {
+            count = 0;
+        }
+
+        uint16_t size() const {
+            return count;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        bool contains(moveType move) const {
+            for (uint16_t i=0; i < count; i++) {
+                if (moves[i] == move) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool moveToFront(moveType move) {
+            // Keeps the order of the other moves, false if the move isn't in the list
+            for (uint16_t i=0; i < count; i++) {
+                if (moves[i] == move) {
+                    std::rotate(moves.begin(), moves.begin() + i, moves.begin() + i + 1);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        template<typename ScoreFunction>
+        void sortByScore(uint16_t start, ScoreFunction getScore) {
+            // Highest score first from start on, equal scores keep their order. Every move is scored once
+            // and sorted by insertion, so ordering never allocates
+            array<uint32_t, MAX_MOVES> scores;
+            for (uint16_t i=start; i < count; i++) {
+                scores[i] = getScore(moves[i]);
+            }
+            for (uint16_t i=start + 1; i < count; i++) {
+                moveType move = moves[i];
+                uint32_t score = scores[i];
+                uint16_t j = i;
+                for (; j > start && scores[j - 1] < score; j--) {
+                    moves[j] = moves[j - 1];
+                    scores[j] = scores[j - 1];
+                }
+                moves[j] = move;
+                scores[j] = score;
+            }
+        }
+
+        moveType& operator[](uint16_t index) {
+            return moves[index];
+        }
+
+        moveType* begin() {
+            return moves.data();
+        }
+
+        moveType* end() {
+            return moves.data() + count;
+        }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef CHESS_PAWN_HASH_H
+#define CHESS_PAWN_HASH_H 1
+#include <vector>
+
+#include "board.cpp"
+#include "statsutil.hpp"
+
+namespace pawnStructure {
+    const unsigned long long fileA = 0x0101010101010101ULL;
+    const unsigned long long fileH = fileA << 7;
+
+    // Bonus for a passed pawn by its rank from its own side, 0 -> first rank
+    const int passedBonus[8] = {0, 5, 10, 20, 35, 60, 100, 0};
+    const int doubledPenalty = 10;
+    const int isolatedPenalty = 10;
+
+    unsigned long long fillNorth(unsigned long long b) {
+        // Towards rank 8, lower indices
+        b |= b >> 8;
+        b |= b >> 16;
+        b |= b >> 32;
+        return b;
+    }
+
+    unsigned long long fillSouth(unsigned long long b) {
+        b |= b << 8;
+        b |= b << 16;
+        b |= b << 32;
+        return b;
+    }
+
+    unsigned long long shiftEast(unsigned long long b) {
+        return (b << 1) & ~fileA;
+    }
+
+    unsigned long long shiftWest(unsigned long long b) {
+        return (b >> 1) & ~fileH;
+    }
+
+    unsigned long long getFrontSpan(unsigned long long pawns, playerType color) {
+        // Squares ahead of the pawns on their own files
+        return color == WHITE ? fillNorth(pawns >> 8) : fillSouth(pawns << 8);
+    }
+
+    unsigned long long getAttackSpan(unsigned long long pawns, playerType color) {
+        // Every square the pawns could attack while advancing
+        unsigned long long frontSpan = getFrontSpan(pawns, color);
+        return shiftEast(frontSpan) | shiftWest(frontSpan);
+    }
+
+    uint8_t getRelativeRank(uint8_t pos, playerType color) {
+        return color == WHITE ? 7 - pos / 8 : pos / 8;
+    }
+};
+
+struct PawnEntry {
+    unsigned long long pawnHash;
+    unsigned long long passedPawns[2]; // [color]
+    unsigned long long attackSpans[2]; // [color]
+    int score; // White's point of view
+};
+
+class PawnHashTable {
+    // Direct mapped cache of pawn structure terms, owned by a single search thread
+    private:
+        std::vector<PawnEntry> entries;
+
+        void evaluate(Board &boardInstance, PawnEntry &entry) {
+            unsigned long long pawns[2] = {
+                boardInstance.getPieces(BLACK, PAWN).to_ullong(),
+                boardInstance.getPieces(WHITE, PAWN).to_ullong()
+            };
+            int scores[2] = {0, 0};
+            for (playerType color=BLACK; color <= WHITE; color++) {
+                unsigned long long ownPawns = pawns[color], enemyPawns = pawns[!color];
+                entry.attackSpans[color] = pawnStructure::getAttackSpan(ownPawns, color);
+                entry.passedPawns[color] = ownPawns & ~(pawnStructure::getFrontSpan(enemyPawns, !color)
+                    | pawnStructure::getAttackSpan(enemyPawns, !color));
+
+                // Pawns with a pawn of the same color ahead of them
+                unsigned long long doubled = ownPawns & pawnStructure::getFrontSpan(ownPawns, !color);
+                unsigned long long files = pawnStructure::fillNorth(pawnStructure::fillSouth(ownPawns));
+                unsigned long long isolated = ownPawns
+                    & ~(pawnStructure::shiftEast(files) | pawnStructure::shiftWest(files));
+
+                scores[color] -= __builtin_popcountll(doubled) * pawnStructure::doubledPenalty;
+                scores[color] -= __builtin_popcountll(isolated) * pawnStructure::isolatedPenalty;
+                boardType passed(entry.passedPawns[color]);
+                for (uint8_t pos=passed._Find_first(); pos < 64; pos=passed._Find_next(pos)) {
+                    scores[color] += pawnStructure::passedBonus[pawnStructure::getRelativeRank(pos, color)];
+                }
+            }
+            entry.pawnHash = boardInstance.getPawnHash();
+            entry.score = scores[WHITE] - scores[BLACK];
+        }
+    public:
+        PawnHashTable() {
+            // Zeroed entries are valid, hash 0 only matches a board without pawns
+            entries = std::vector<PawnEntry>(PAWN_HASH_ENTRIES, PawnEntry{0, {0, 0}, {0, 0}, 0});
+        }
+
+        const PawnEntry& probe(Board &boardInstance) {
+            PawnEntry &entry = entries[boardInstance.getPawnHash() & (PAWN_HASH_ENTRIES - 1)];
+            if (entry.pawnHash == boardInstance.getPawnHash()) {
+                stats::hitPawnHash();
+            } else {
+                stats::missPawnHash();
+                evaluate(boardInstance, entry);
+            }
+            return entry;
+        }
+
+        void clear() {
+            std::fill(entries.begin(), entries.end(), PawnEntry{0, {0, 0}, {0, 0}, 0});
+        }
+};
+
+#endif
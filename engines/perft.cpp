@@ -0,0 +1,19 @@
+#include <iostream>
+
+#include "board.cpp"
+#include "perft.hpp"
+#include "preCalculation.hpp"
+
+int main(int argc, char **argv) {
+    // perft.out [threads] [hashMB]
+    // Runs the standard suite and fails if any leaf count differs from the known one
+    preCalculation::preCalcType preCalcData = preCalculation::load();
+    unsigned int threads = argc > 1 ? std::stoi(argv[1]) : 1;
+    unsigned int hashMB = argc > 2 ? std::stoi(argv[2]) : 0;
+    if (!perft::runSuite(preCalcData, threads, hashMB)) {
+        std::cout << "Perft suite failed" << std::endl;
+        return 1;
+    }
+    std::cout << "Perft suite passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,193 @@
+#ifndef CHESS_PERFT_H
+#define CHESS_PERFT_H 1
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include "board.cpp"
+#include "moveList.hpp"
+#include "preCalculation.hpp"
+
+using std::string;
+using std::vector;
+
+namespace perft {
+    struct PerftEntry {
+        unsigned long long zobristHash;
+        unsigned long long nodes;
+        uint8_t depth;
+    };
+
+    class PerftTable {
+        // Counts of already visited subtrees, keyed by hash and depth
+        private:
+            vector<PerftEntry> entries;
+            unsigned long long mask = 0;
+        public:
+            PerftTable(unsigned int sizeMB = 0) {
+                if (sizeMB == 0) {
+                    return;
+                }
+                unsigned long long count = 1;
+                while (count * 2 * sizeof(PerftEntry) <= (unsigned long long) sizeMB * 1024 * 1024) {
+                    count *= 2;
+                }
+                entries = vector<PerftEntry>(count, {0, 0, 0});
+                mask = count - 1;
+            }
+
+            bool isEnabled() {
+                return !entries.empty();
+            }
+
+            bool get(unsigned long long zobristHash, uint8_t depth, unsigned long long &nodes) {
+                PerftEntry &entry = entries[zobristHash & mask];
+                if (entry.zobristHash == zobristHash && entry.depth == depth) {
+                    nodes = entry.nodes;
+                    return true;
+                }
+                return false;
+            }
+
+            void set(unsigned long long zobristHash, uint8_t depth, unsigned long long nodes) {
+                entries[zobristHash & mask] = {zobristHash, nodes, depth};
+            }
+    };
+
+    struct PerftResult {
+        unsigned long long nodes;
+        long long elapsedMs;
+
+        unsigned long long nodesPerSecond() {
+            return nodes * 1000 / std::max(elapsedMs, 1LL);
+        }
+    };
+
+    struct PerftPosition {
+        string fen;
+        uint8_t depth;
+        unsigned long long nodes;
+    };
+
+    // Well known positions and their leaf counts
+    const PerftPosition standardSuite[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487},
+        {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594},
+    };
+
+    unsigned long long countLeaves(Board &boardInstance, preCalculation::preCalcType &preCalcData, uint8_t depth, PerftTable &table) {
+        if (depth == 0) {
+            return 1;
+        }
+        unsigned long long nodes = 0;
+        if (table.isEnabled() && table.get(boardInstance.getZobristHash(), depth, nodes)) {
+            return nodes;
+        }
+        MoveList moves;
+        boardInstance.getNextMoves(preCalcData, moves, boardInstance.player);
+        if (depth == 1) {
+            // Every generated move is legal, no need to make them
+            return moves.size();
+        }
+        for (moveType move: moves) {
+            boardInstance.makeMove(move, preCalcData->PRN);
+            nodes += countLeaves(boardInstance, preCalcData, depth - 1, table);
+            boardInstance.unmakeMove();
+        }
+        if (table.isEnabled()) {
+            table.set(boardInstance.getZobristHash(), depth, nodes);
+        }
+        return nodes;
+    }
+
+    vector<std::pair<moveType, unsigned long long>> divide(Board &boardInstance, preCalculation::preCalcType &preCalcData, uint8_t depth, unsigned int threads = 1, unsigned int hashMB = 0) {
+        // Leaf count below every legal root move, root moves are split between the threads
+        MoveList moves;
+        vector<std::pair<moveType, unsigned long long>> results;
+        boardInstance.getNextMoves(preCalcData, moves, boardInstance.player);
+        for (moveType move: moves) {
+            results.push_back({move, depth <= 1 ? 1 : 0});
+        }
+        if (depth <= 1) {
+            return results;
+        }
+
+        threads = std::max(1u, std::min(threads, (unsigned int) results.size()));
+        vector<std::thread> workers;
+        for (unsigned int thread=0; thread < threads; thread++) {
+            workers.emplace_back([&, thread]() {
+                Board threadBoard(boardInstance);
+                PerftTable table(hashMB);
+                for (size_t i=thread; i < results.size(); i += threads) {
+                    threadBoard.makeMove(results[i].first, preCalcData->PRN);
+                    results[i].second = countLeaves(threadBoard, preCalcData, depth - 1, table);
+                    threadBoard.unmakeMove();
+                }
+            });
+        }
+        for (auto &worker: workers) {
+            worker.join();
+        }
+        return results;
+    }
+
+    PerftResult run(Board &boardInstance, preCalculation::preCalcType &preCalcData, uint8_t depth, unsigned int threads = 1, unsigned int hashMB = 0) {
+        auto start = std::chrono::steady_clock::now();
+        unsigned long long nodes = 0;
+        if (depth == 0) {
+            nodes = 1;
+        } else {
+            for (auto &result: divide(boardInstance, preCalcData, depth, threads, hashMB)) {
+                nodes += result.second;
+            }
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return {nodes, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()};
+    }
+
+    void printResult(PerftResult result) {
+        std::cout << std::endl << "Nodes searched: " << result.nodes << std::endl;
+        std::cout << "Time(ms): " << result.elapsedMs << std::endl;
+        std::cout << "Nodes/second: " << result.nodesPerSecond() << std::endl;
+    }
+
+    void printDivide(Board &boardInstance, preCalculation::preCalcType &preCalcData, uint8_t depth, unsigned int threads = 1, unsigned int hashMB = 0) {
+        auto start = std::chrono::steady_clock::now();
+        unsigned long long nodes = 0;
+        for (auto &result: divide(boardInstance, preCalcData, depth, threads, hashMB)) {
+            std::cout << moveUtils::toNotation(result.first) << ": " << result.second << std::endl;
+            nodes += result.second;
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        printResult({nodes, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()});
+    }
+
+    bool runSuite(preCalculation::preCalcType &preCalcData, unsigned int threads = 1, unsigned int hashMB = 0) {
+        // Returns false if any position doesn't match its known count
+        bool isPassed = true;
+        unsigned long long totalNodes = 0;
+        long long totalMs = 0;
+        for (const PerftPosition &position: standardSuite) {
+            Board boardInstance(position.fen, preCalcData->PRN);
+            PerftResult result = run(boardInstance, preCalcData, position.depth, threads, hashMB);
+            bool isCorrect = result.nodes == position.nodes;
+            isPassed = isPassed && isCorrect;
+            totalNodes += result.nodes;
+            totalMs += result.elapsedMs;
+            std::cout << (isCorrect ? "OK   " : "FAIL ") << position.fen << " depth " << (int) position.depth
+                << " nodes " << result.nodes << " expected " << position.nodes
+                << " time(ms) " << result.elapsedMs << " nps " << result.nodesPerSecond() << std::endl;
+        }
+        printResult({totalNodes, totalMs});
+        return isPassed;
+    }
+};
+
+#endif
@@ -0,0 +1,4 @@
+#!/bin/sh
+set -e
+g++ -O2 -pthread -std=c++20 /app/engines/perft.cpp -o /app/engines/perft.out
+/app/engines/perft.out "$@"
@@ -4,15 +4,53 @@
 #include<string>
 #include<fstream>
 #include<memory>
+#include<cstdlib>
+#include<cstddef>
+#include<cstring>
+#include<chrono>
+#include<cstdio>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<fcntl.h>
+#include<unistd.h>
 
 #include "definitions.hpp"
 #include "log.hpp"
 
+// Sliding attacks are indexed with magics unless built with -DUSE_PEXT, which needs -mbmi2.
+// PEXT is opt in: the binary then only runs on BMI2 CPUs and is slow on AMD before Zen 3.
+#ifdef USE_PEXT
+#ifndef __BMI2__
+#error "USE_PEXT needs a BMI2 build(-mbmi2)"
+#endif
+#include<immintrin.h>
+#endif
+
 using std::array;
 using std::string;
 
 namespace preCalculation {
+    const string textFile = "/app/engines/utils/preCalc.dat";
+    const string binaryFile = "/app/engines/utils/preCalc.bin";
+    const char binaryMagic[8] = {'C', 'H', 'S', 'P', 'R', 'E', 'C', 'A'};
+    // Bump whenever the stored fields of preCalc change
+    const uint32_t binaryVersion = 1;
+    // Header takes a whole page so the payload can be mapped page aligned
+    const size_t binaryHeaderSize = 4096;
+
+    struct BinaryHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+        uint64_t payloadSize;
+        uint64_t checksum;
+    };
+
+    // Time taken by the last load(), reported in the logs
+    long long loadTimeUs = 0;
+
     struct preCalc {
+        // Stored fields come first, the binary file is a raw image of them up to PRN
         array<array<boardType, 512>, 64> bishopLookup;
         array<array<boardType, 4096>, 64> rookLookup;
         array<unsigned long long, 64> bishopMagic;
@@ -20,6 +58,19 @@ namespace preCalculation {
         array<boardType, 64> bishopBlockers;
         array<boardType, 64> rookBlockers;
         prnType PRN;
+        // Derived tables, computed on load rather than stored in preCalc.dat
+        array<boardType, 64> knightAttacks;
+        array<boardType, 64> kingAttacks;
+        array<array<boardType, 64>, 2> pawnAttacks; // [color][pos]
+        array<array<boardType, 64>, 2> pawnPushes; // [color][pos] Single push
+        array<array<boardType, 64>, 2> pawnDoublePushes; // [color][pos] Only from the initial rank
+        array<array<boardType, 64>, 64> between; // Squares strictly between two aligned squares
+        array<array<boardType, 64>, 64> line; // Full rank, file or diagonal through two aligned squares
+#ifdef USE_PEXT
+        // Same attacks as the magic lookups, indexed by the blockers extracted with PEXT
+        array<array<boardType, 512>, 64> bishopPextLookup;
+        array<array<boardType, 4096>, 64> rookPextLookup;
+#endif
         bool operator==(const preCalc &other);
     };
 
@@ -90,14 +141,200 @@ namespace preCalculation {
         return os;
     }
 
-    preCalcType load() {
+    boardType getStepTargets(uint8_t pos, const int (&steps)[8][2]) {
+        // Targets of a leaper, steps are {rank, file} offsets
+        boardType targets = boardType(0);
+        for (auto &step: steps) {
+            int rank = pos / 8 + step[0], file = pos % 8 + step[1];
+            if (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+                targets.set(rank * 8 + file);
+            }
+        }
+        return targets;
+    }
+
+#ifdef USE_PEXT
+    void computePextTables(preCalc &data) {
+        // Walk every subset of each blocker mask and move its magic entry to the PEXT index
+        for (uint8_t pos=0; pos < 64; pos++) {
+            unsigned long long mask = data.bishopBlockers[pos].to_ullong(), subset = 0;
+            do {
+                uint16_t magicIndex = (subset * data.bishopMagic[pos]) >> (64 - 9);
+                data.bishopPextLookup[pos][_pext_u64(subset, mask)] = data.bishopLookup[pos][magicIndex];
+                subset = (subset - mask) & mask;
+            } while (subset);
+
+            mask = data.rookBlockers[pos].to_ullong();
+            subset = 0;
+            do {
+                uint16_t magicIndex = (subset * data.rookMagic[pos]) >> (64 - 12);
+                data.rookPextLookup[pos][_pext_u64(subset, mask)] = data.rookLookup[pos][magicIndex];
+                subset = (subset - mask) & mask;
+            } while (subset);
+        }
+    }
+#endif
+
+    void computeTables(preCalc &data) {
+        const int knightSteps[8][2] = {{-2, -1}, {-2, 1}, {-1, -2}, {-1, 2}, {1, -2}, {1, 2}, {2, -1}, {2, 1}};
+        const int kingSteps[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1}, {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+        for (uint8_t pos=0; pos < 64; pos++) {
+            data.knightAttacks[pos] = getStepTargets(pos, knightSteps);
+            data.kingAttacks[pos] = getStepTargets(pos, kingSteps);
+            for (playerType color: {BLACK, WHITE}) {
+                // White moves towards rank 8, which is index 0
+                int direction = color == WHITE ? -1 : 1;
+                int nextRank = pos / 8 + direction;
+                data.pawnAttacks[color][pos] = boardType(0);
+                data.pawnPushes[color][pos] = boardType(0);
+                data.pawnDoublePushes[color][pos] = boardType(0);
+                if (nextRank < 0 || nextRank > 7) {
+                    continue;
+                }
+                data.pawnPushes[color][pos].set(nextRank * 8 + pos % 8);
+                if (pos % 8 != 0) {
+                    data.pawnAttacks[color][pos].set(nextRank * 8 + pos % 8 - 1);
+                }
+                if (pos % 8 != 7) {
+                    data.pawnAttacks[color][pos].set(nextRank * 8 + pos % 8 + 1);
+                }
+                if (pos / 8 == (color == WHITE ? 6 : 1)) {
+                    data.pawnDoublePushes[color][pos].set(pos + direction * 16);
+                }
+            }
+        }
+
+        for (uint8_t from=0; from < 64; from++) {
+            for (uint8_t to=0; to < 64; to++) {
+                data.between[from][to] = boardType(0);
+                data.line[from][to] = boardType(0);
+                int fileDiff = to % 8 - from % 8, rankDiff = to / 8 - from / 8;
+                if (from == to || (fileDiff != 0 && rankDiff != 0 && abs(fileDiff) != abs(rankDiff))) {
+                    continue;
+                }
+                int rankStep = (rankDiff > 0) - (rankDiff < 0), fileStep = (fileDiff > 0) - (fileDiff < 0);
+                for (int pos = from + rankStep * 8 + fileStep; pos != to; pos += rankStep * 8 + fileStep) {
+                    data.between[from][to].set(pos);
+                }
+                // Walk both ways from one end until the edge of the board
+                for (int sign: {-1, 1}) {
+                    int rank = from / 8, file = from % 8;
+                    while (rank >= 0 && rank < 8 && file >= 0 && file < 8) {
+                        data.line[from][to].set(rank * 8 + file);
+                        rank += sign * rankStep;
+                        file += sign * fileStep;
+                    }
+                }
+            }
+        }
+#ifdef USE_PEXT
+        computePextTables(data);
+#endif
+    }
+
+    size_t getStoredSize() {
+        return offsetof(preCalc, PRN) + sizeof(prnType);
+    }
+
+    uint64_t getChecksum(const char *payload, size_t size) {
+        // FNV-1a over 64 bit words, the payload size is always a multiple of 8
+        uint64_t checksum = 14695981039346656037ULL;
+        for (size_t i=0; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, payload + i, 8);
+            checksum = (checksum ^ word) * 1099511628211ULL;
+        }
+        return checksum;
+    }
+
+    preCalcType loadText() {
         preCalcType data = std::make_shared<preCalc>();
-        std::ifstream file("/app/engines/utils/preCalc.dat");
+        std::ifstream file(textFile);
         file >> *data;
         file.close();
         return data;
     }
 
+    preCalcType loadBinary() {
+        // Maps the file in place, the derived tables after the stored fields live in anonymous memory.
+        // Returns nullptr if the file is missing or doesn't match this build.
+        int fd = open(binaryFile.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat fileStat;
+        size_t fileSize = binaryHeaderSize + getStoredSize();
+        if (fstat(fd, &fileStat) != 0 || (size_t) fileStat.st_size != fileSize) {
+            logging::w("PreCalc", "Binary precalc has the wrong size, rebuild it with convertPreCalc");
+            close(fd);
+            return nullptr;
+        }
+        size_t totalSize = binaryHeaderSize + sizeof(preCalc);
+        char *base = (char *) mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            close(fd);
+            return nullptr;
+        }
+        if (mmap(base, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            munmap(base, totalSize);
+            close(fd);
+            return nullptr;
+        }
+        close(fd);
+
+        BinaryHeader *header = (BinaryHeader *) base;
+        char *payload = base + binaryHeaderSize;
+        if (std::memcmp(header->magic, binaryMagic, sizeof(binaryMagic)) != 0
+            || header->version != binaryVersion
+            || header->headerSize != binaryHeaderSize
+            || header->payloadSize != getStoredSize()
+            || header->checksum != getChecksum(payload, getStoredSize())) {
+
+            logging::w("PreCalc", "Binary precalc is invalid or outdated, rebuild it with convertPreCalc");
+            munmap(base, totalSize);
+            return nullptr;
+        }
+        return preCalcType((preCalc *) payload, [base, totalSize](preCalc *) {
+            munmap(base, totalSize);
+        });
+    }
+
+    bool writeBinary(const string &path, preCalc &data) {
+        // Written to a temporary file first so a reader never maps a partial file
+        BinaryHeader header;
+        std::memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+        header.version = binaryVersion;
+        header.headerSize = binaryHeaderSize;
+        header.payloadSize = getStoredSize();
+        header.checksum = getChecksum((const char *) &data, getStoredSize());
+
+        string tempPath = path + ".tmp";
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        array<char, binaryHeaderSize> headerPage = {};
+        std::memcpy(headerPage.data(), &header, sizeof(header));
+        file.write(headerPage.data(), headerPage.size());
+        file.write((const char *) &data, getStoredSize());
+        file.close();
+        if (!file) {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+        return std::rename(tempPath.c_str(), path.c_str()) == 0;
+    }
+
+    preCalcType load() {
+        auto start = std::chrono::steady_clock::now();
+        preCalcType data = loadBinary();
+        if (data == nullptr) {
+            data = loadText();
+        }
+        computeTables(*data);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        loadTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+        logging::i("PreCalc load time(us): ", loadTimeUs);
+        return data;
+    }
+
     // preCalcType loadJSON() {
     //     // Load the magics and blockers
     //     string attacksFile = "/app/engines/utils/attacks.json";
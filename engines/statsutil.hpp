@@ -5,120 +5,204 @@
 #include "log.hpp"
 
 namespace stats {
-    unsigned long pruneCount;
-    unsigned long heruisticCount;
-    
-    unsigned long ttExactHits;
-    unsigned long ttAlphaHits;
-    unsigned long ttBetaHits;
-    unsigned long ttMisses;
-    unsigned long ttCollisions;
-    unsigned long ttInserts;
-    unsigned long ttExactInconsistent;
-
-    unsigned long pvNullWindowSuccess;
-    unsigned long pvNullWindowFail;
-
-    unsigned long nullMovePruned;
-    unsigned long nullMoveNotPruned;
-
-    unsigned long illegalKingCapturePrune;
-
-    unsigned long qSearchCount;
+    struct Counters {
+        unsigned long nodeCount = 0;
+        unsigned long pruneCount = 0;
+        unsigned long cutoffCount = 0;
+        unsigned long firstMoveCutoffCount = 0;
+        unsigned long heruisticCount = 0;
+
+        unsigned long ttExactHits = 0;
+        unsigned long ttAlphaHits = 0;
+        unsigned long ttBetaHits = 0;
+        unsigned long ttMisses = 0;
+        unsigned long ttCollisions = 0;
+        unsigned long ttInserts = 0;
+        unsigned long ttExactInconsistent = 0;
+
+        unsigned long pvNullWindowSuccess = 0;
+        unsigned long pvNullWindowFail = 0;
+
+        unsigned long nullMovePruned = 0;
+        unsigned long nullMoveNotPruned = 0;
+
+        unsigned long aspirationFailLows = 0;
+        unsigned long aspirationFailHighs = 0;
+
+        unsigned long qSearchCount = 0;
+        unsigned long seePruned = 0;
+
+        unsigned long pawnHashHits = 0;
+        unsigned long pawnHashMisses = 0;
+
+        unsigned long evalCacheHits = 0;
+        unsigned long evalCacheMisses = 0;
+
+        Counters& operator+=(const Counters &other) {
+            nodeCount += other.nodeCount;
+            pruneCount += other.pruneCount;
+            cutoffCount += other.cutoffCount;
+            firstMoveCutoffCount += other.firstMoveCutoffCount;
+            heruisticCount += other.heruisticCount;
+            ttExactHits += other.ttExactHits;
+            ttAlphaHits += other.ttAlphaHits;
+            ttBetaHits += other.ttBetaHits;
+            ttMisses += other.ttMisses;
+            ttCollisions += other.ttCollisions;
+            ttInserts += other.ttInserts;
+            ttExactInconsistent += other.ttExactInconsistent;
+            pvNullWindowSuccess += other.pvNullWindowSuccess;
+            pvNullWindowFail += other.pvNullWindowFail;
+            nullMovePruned += other.nullMovePruned;
+            nullMoveNotPruned += other.nullMoveNotPruned;
+            aspirationFailLows += other.aspirationFailLows;
+            aspirationFailHighs += other.aspirationFailHighs;
+            qSearchCount += other.qSearchCount;
+            seePruned += other.seePruned;
+            pawnHashHits += other.pawnHashHits;
+            pawnHashMisses += other.pawnHashMisses;
+            evalCacheHits += other.evalCacheHits;
+            evalCacheMisses += other.evalCacheMisses;
+            return *this;
+        }
+    };
+
+    // Every search thread counts into its own copy, helpers add theirs to the main thread's when done
+    thread_local Counters counters;
+
+    // Set once per process around the search, not cleared by reset
+    long long ttLoadTimeUs;
+    long long ttStoreTimeUs;
 
     std::chrono::_V2::system_clock::time_point startTime;
 
+    void printTTTimes() {
+        logging::i("TT Load Time(us): ", ttLoadTimeUs);
+        logging::i("TT Store Time(us): ", ttStoreTimeUs);
+    }
+
     void printStats() {
         auto now = std::chrono::system_clock::now();
         logging::i("Elapsed time(s): ", std::chrono::duration_cast<std::chrono::seconds>(now - startTime).count());
-        logging::i("Prune count: ", pruneCount);
-        logging::i("Heruistic count: ", heruisticCount);
-        logging::i("QSearch Count: ", qSearchCount);
-        logging::i("TT Exact Hits: ", ttExactHits);
-        logging::i("TT Alpha Hits: ", ttAlphaHits);
-        logging::i("TT Beta Hits: ", ttBetaHits);
-        logging::i("TT Misses: ", ttMisses);
-        logging::i("TT Collisions: ", ttCollisions);
-        logging::i("TT Inserts: ", ttInserts);
-        logging::i("TT Exact Inconsistent", ttExactInconsistent);
-        logging::i("PV Null Window Success: ", pvNullWindowSuccess);
-        logging::i("PV Null Window Fail: ", pvNullWindowFail);
-        logging::i("Null Move Pruned: ", nullMovePruned);
-        logging::i("Null Move Not Pruned: ", nullMoveNotPruned);
-        logging::i("Illegal King Capture Prune: ", illegalKingCapturePrune);
+        logging::i("Node count: ", counters.nodeCount);
+        logging::i("Prune count: ", counters.pruneCount);
+        logging::i("Beta cutoffs: ", counters.cutoffCount);
+        logging::i("First move beta cutoffs: ", counters.firstMoveCutoffCount);
+        logging::i("Heruistic count: ", counters.heruisticCount);
+        logging::i("QSearch Count: ", counters.qSearchCount);
+        logging::i("SEE Pruned Captures: ", counters.seePruned);
+        logging::i("TT Exact Hits: ", counters.ttExactHits);
+        logging::i("TT Alpha Hits: ", counters.ttAlphaHits);
+        logging::i("TT Beta Hits: ", counters.ttBetaHits);
+        logging::i("TT Misses: ", counters.ttMisses);
+        logging::i("TT Collisions: ", counters.ttCollisions);
+        logging::i("TT Inserts: ", counters.ttInserts);
+        logging::i("TT Exact Inconsistent", counters.ttExactInconsistent);
+        logging::i("PV Null Window Success: ", counters.pvNullWindowSuccess);
+        logging::i("PV Null Window Fail: ", counters.pvNullWindowFail);
+        logging::i("Null Move Pruned: ", counters.nullMovePruned);
+        logging::i("Null Move Not Pruned: ", counters.nullMoveNotPruned);
+        logging::i("Aspiration Fail Low Re-searches: ", counters.aspirationFailLows);
+        logging::i("Aspiration Fail High Re-searches: ", counters.aspirationFailHighs);
+        logging::i("Pawn Hash Hits: ", counters.pawnHashHits);
+        logging::i("Pawn Hash Misses: ", counters.pawnHashMisses);
+        logging::i("Eval Cache Hits: ", counters.evalCacheHits);
+        logging::i("Eval Cache Misses: ", counters.evalCacheMisses);
+        printTTTimes();
     }
 
     void hitTTExact() {
-        ttExactHits++;
+        counters.ttExactHits++;
     }
 
     void hitTTAlpha() {
-        ttAlphaHits++;
+        counters.ttAlphaHits++;
     }
 
     void hitTTBeta() {
-        ttBetaHits++;
+        counters.ttBetaHits++;
     }
 
     void collisionTT() {
-        ttCollisions++;
+        counters.ttCollisions++;
     }
 
     void insertTT() {
-        ttInserts++;
+        counters.ttInserts++;
     }
 
     void missTT() {
-        ttMisses++;
+        counters.ttMisses++;
+    }
+
+    void node() {
+        counters.nodeCount++;
     }
 
     void prune() {
-        pruneCount++;
+        counters.pruneCount++;
+    }
+
+    void cutoff(bool isFirstMove) {
+        counters.cutoffCount++;
+        counters.firstMoveCutoffCount += isFirstMove;
     }
 
     void heruistic() {
-        heruisticCount++;
+        counters.heruisticCount++;
     }
 
     void pvZWSSuccess() {
-        pvNullWindowSuccess++;
+        counters.pvNullWindowSuccess++;
     }
 
     void pvZWSFail() {
-        pvNullWindowFail++;
+        counters.pvNullWindowFail++;
     }
 
     void nullMovePrune() {
-        nullMovePruned++;
+        counters.nullMovePruned++;
     }
 
     void nullMoveNotPrune() {
-        nullMoveNotPruned++;
+        counters.nullMoveNotPruned++;
     }
 
-    void illegalKingCapture() {
-        illegalKingCapturePrune++;
+    void aspirationFailLow() {
+        counters.aspirationFailLows++;
+    }
+
+    void aspirationFailHigh() {
+        counters.aspirationFailHighs++;
     }
 
     void quiescenceSearch() {
-        qSearchCount++;
+        counters.qSearchCount++;
+    }
+
+    void seePrune() {
+        counters.seePruned++;
+    }
+
+    void hitPawnHash() {
+        counters.pawnHashHits++;
     }
 
+    void missPawnHash() {
+        counters.pawnHashMisses++;
+    }
+
+    void hitEvalCache() {
+        counters.evalCacheHits++;
+    }
+
+    void missEvalCache() {
+        counters.evalCacheMisses++;
+    }
 
     void reset() {
         startTime = std::chrono::system_clock::now();
-        pruneCount = 0;
-        heruisticCount = 0;
-        ttExactHits = 0;
-        ttAlphaHits = 0;
-        ttBetaHits = 0;
-        ttMisses = 0;
-        ttCollisions = 0;
-        ttInserts = 0;
-        ttExactInconsistent = 0;
-        pvNullWindowSuccess = 0;
-        pvNullWindowFail = 0;
-        illegalKingCapturePrune = 0;
+        counters = Counters();
     }
 }
 
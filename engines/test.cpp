@@ -1,4 +1,6 @@
 #include <iostream>
+#include <fstream>
+#include <random>
 
 #include "board.cpp"
 #include "chessBot.hpp"
@@ -11,23 +13,22 @@ class TestCase {
         ChessBot bot;
         preCalculation::preCalcType preCalculatedData;
     public:
-        TestCase(preCalculation::preCalcType preCalcData) {
+        // ChessBot can't be assigned, it owns an atomic stop flag
+        TestCase(preCalculation::preCalcType preCalcData) : bot(randomUtils::getHashFileName(), preCalcData) {
             preCalculatedData = preCalcData;
             board = Board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 1 1", preCalculatedData->PRN);
-            bot = ChessBot(randomUtils::getHashFileName(), preCalculatedData);
         }
-        TestCase(const TestCase& otherTestCase) {
+        TestCase(const TestCase& otherTestCase) : bot(otherTestCase.bot) {
             this->preCalculatedData = otherTestCase.preCalculatedData;
             this->board = Board(otherTestCase.board);
-            this->bot = ChessBot(otherTestCase.bot);
         }
         void playMove() {
             bot.getNextMove(board);
         }
-        Board getBoard() {
+        Board& getBoard() {
             return board;
         }
-        ChessBot getBot() {
+        ChessBot& getBot() {
             return bot;
         }
 };
@@ -56,7 +57,110 @@ void verifyAlphaBetaPruning(preCalculation::preCalcType preCalcData) {
     }
 }
 
-int main() {
+void verifyZobristConsistency(preCalculation::preCalcType preCalcData, int games) {
+    // Random playouts, the incremental hash has to match a full recalculation after every make and unmake,
+    // and the key predicted before each move
+    const string fens[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 1 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    };
+    std::mt19937 rng(games);
+    for (const string &fen: fens) {
+        for (int game=0; game < games; game++) {
+            Board board(fen, preCalcData->PRN);
+            for (int ply=0; ply < 100; ply++) {
+                MoveList moves;
+                board.orderedNextMoves(preCalcData, moves, board.player);
+                if (moves.empty()) {
+                    break;
+                }
+                unsigned long long hash = board.getZobristHash();
+                for (moveType move: moves) {
+                    unsigned long long keyAfterMove = board.getKeyAfterMove(move, preCalcData->PRN);
+                    board.makeMove(move, preCalcData->PRN);
+                    assert(board.getZobristHash() == board.computeZobristHash(preCalcData->PRN));
+                    assert(board.getZobristHash() == keyAfterMove);
+                    assert(board.getPawnHash() == board.computePawnHash(preCalcData->PRN));
+                    board.unmakeMove();
+                    assert(board.getZobristHash() == hash);
+                }
+                board.makeNullMove(preCalcData->PRN);
+                assert(board.getZobristHash() == board.computeZobristHash(preCalcData->PRN));
+                board.unmakeNullMove();
+                assert(board.getZobristHash() == hash);
+
+                moveType move = moves[rng() % moves.size()];
+                if (tolower(board.pieceAt(moveUtils::getTarget(move))) == 'k') {
+                    break;
+                }
+                board.makeMove(move, preCalcData->PRN);
+            }
+        }
+    }
+}
+
+void verifyStaticExchange(preCalculation::preCalcType preCalcData) {
+    // Exchanges with known outcomes, in the piece values used by Board::see
+    struct Exchange {
+        string fen;
+        string move;
+        int score;
+    };
+    const Exchange exchanges[] = {
+        {"1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1e5", 50},
+        {"1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1", "d3e5", -100},
+        {"4k3/8/3p4/4p3/8/8/8/4QK2 w - - 0 1", "e1e5", -450},
+        {"4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5d6", 50},
+    };
+    for (const Exchange &exchange: exchanges) {
+        Board board(exchange.fen, preCalcData->PRN);
+        assert(board.see(preCalcData, board.parseMove(exchange.move)) == exchange.score);
+    }
+}
+
+void verifyOpeningBook(preCalculation::preCalcType preCalcData) {
+    // Key from the Polyglot specification, then a small book written here with the entries sorted by key
+    Board board("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", preCalcData->PRN);
+    unsigned long long key = book::getKey(board);
+    assert(key == 0x463b96181691fc9cULL);
+
+    // Polyglot moves, to square in bits 0-5 and from square in bits 6-11, rows from rank 1
+    const book::BookEntry entries[] = {
+        {key - 1, 796, 50, 0}, // Another position
+        {key, 796, 10, 0}, // e2e4
+        {key, 804, 30, 0}, // e2e5, illegal
+        {key, 731, 20, 0}, // d2d4
+        {key + 1, 731, 50, 0}, // Another position
+    };
+    const string bookFile = "/tmp/" + randomUtils::getHashFileName() + ".bin";
+    std::ofstream file(bookFile, std::ios::binary);
+    for (book::BookEntry entry: entries) {
+        entry.key = __builtin_bswap64(entry.key);
+        entry.move = __builtin_bswap16(entry.move);
+        entry.weight = __builtin_bswap16(entry.weight);
+        file.write((const char *) &entry, sizeof(entry));
+    }
+    file.close();
+
+    book::OpeningBook openingBook;
+    assert(openingBook.open(bookFile));
+    assert(moveUtils::toNotation(openingBook.probe(board, preCalcData)) == "d2d4");
+    board.makeMove(openingBook.probe(board, preCalcData), preCalcData->PRN);
+    assert(openingBook.probe(board, preCalcData) == NULL_MOVE);
+    std::remove(bookFile.c_str());
+}
+
+int main(int argc, char **argv) {
     preCalculation::preCalcType preCalcData = preCalculation::load();
+    if (argc > 1 && string(argv[1]) == "zobrist") {
+        // Hash consistency only: test.out zobrist [games]
+        verifyZobristConsistency(preCalcData, argc > 2 ? std::stoi(argv[2]) : 100);
+        return 0;
+    }
+    verifyZobristConsistency(preCalcData, 10);
+    verifyStaticExchange(preCalcData);
+    verifyOpeningBook(preCalcData);
     verifyAlphaBetaPruning(preCalcData);
 }
@@ -0,0 +1,44 @@
+#ifndef CHESS_TIME_MANAGEMENT_H
+#define CHESS_TIME_MANAGEMENT_H 1
+#include <algorithm>
+
+#include "definitions.hpp"
+
+namespace timeManagement {
+    struct TimeBudget {
+        // Milliseconds, 0 -> no limit
+        long softMs;
+        long hardMs;
+        // Whether the soft budget follows the stability of the best move
+        bool isAdaptive;
+
+        bool isLimited() {
+            return hardMs > 0;
+        }
+    };
+
+    const TimeBudget unlimited = {0, 0, false};
+
+    TimeBudget fromMoveTime(long moveTimeMs) {
+        // Fixed time, every iteration that fits is searched
+        long timeMs = std::max(moveTimeMs - MOVE_OVERHEAD_MS, 1L);
+        return {timeMs, timeMs, false};
+    }
+
+    TimeBudget fromClock(long timeLeftMs, long incrementMs, int movesToGo) {
+        // The soft budget is an even share of the clock, the hard one allows overshooting it on hard moves
+        long available = std::max(timeLeftMs - MOVE_OVERHEAD_MS, 1L);
+        long moves = movesToGo > 0 ? movesToGo : DEFAULT_MOVES_TO_GO;
+        long hardMs = std::min(available, (available / moves + incrementMs) * HARD_TIME_FACTOR);
+        long softMs = std::min(hardMs, available / moves + incrementMs * 3 / 4);
+        return {std::max(softMs, 1L), std::max(hardMs, 1L), true};
+    }
+
+    double getStabilityScale(uint8_t stableIterations) {
+        // A best move that keeps changing gets more time, one that holds across iterations less
+        const double scales[] = {1.5, 1.25, 1.0, 0.8, 0.65, 0.5};
+        return scales[std::min(stableIterations, (uint8_t) 5)];
+    }
+};
+
+#endif
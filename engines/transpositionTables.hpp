@@ -2,6 +2,18 @@
 #define CHESS_TT_H 1
 #include <fstream>
 #include <memory>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include <climits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "definitions.hpp"
 #include "statsutil.hpp"
 
@@ -10,170 +22,282 @@
 #define TT_LB 3
 
 class HashEntry {
+    // Packed into 16 bytes, 4 entries per bucket
     public:
         unsigned long long zobristHash;
-        long score;
+        moveType bestMove;
+        int16_t score;
         uint8_t depth;
         uint8_t flag;
-        bool isAncient;
-        moveType bestMove;
+        uint8_t generation; // Search generation of the last write or hit
 
         HashEntry() {
-            isAncient = true;
+            zobristHash = 0;
+            score = 0;
+            generation = 0;
             depth = 0;
+            flag = 0;
+            bestMove = NULL_MOVE;
         }
 
         HashEntry(unsigned long long hash, uint8_t depth, long score, uint8_t flag, moveType bestMove) {
             this->zobristHash = hash;
-            this->isAncient = false;
+            this->generation = 0;
             this->depth = depth;
             this->flag = flag;
             this->bestMove = bestMove;
-            this->score = score;
+            this->score = std::clamp(score, (long) MIN_SCORE, (long) MAX_SCORE);
         }
 
-        bool replaceHash(const HashEntry &newHash) {
-            if(!this->isAncient)
-                // This hash is not old
-                return false;
-            if(this->depth > newHash.depth)
-                // This hash searched deeper
-                return false;
-            if(this->depth < newHash.depth)
-                // New hash searched deeper
-                return true;
-            if(newHash.flag == TT_EXACT && this->flag != TT_EXACT)
-                // New hash has exact value
-                return true;
-            if(this->flag == TT_EXACT && newHash.flag != TT_EXACT)
-                // Old hash has exact value
-                return false;
+        bool isEmpty() const {
+            return flag == 0;
+        }
 
-            if (this->score != newHash.score && newHash.flag != TT_LB && this->flag != TT_LB) {
-                return this->score < newHash.score;
+        uint8_t getAge(uint8_t currentGeneration) const {
+            // Searches since the last write or hit, wraps with the generation
+            return (uint8_t) (currentGeneration - generation);
+        }
+
+        int getReplacementValue(uint8_t currentGeneration) const {
+            // Lowest is replaced first, deep entries of recent searches are kept
+            return isEmpty() ? INT_MIN : depth - TT_AGE_WEIGHT * getAge(currentGeneration);
+        }
+
+        bool replaceHash(const HashEntry &newHash, uint8_t currentGeneration) const {
+            if (isEmpty() || getAge(currentGeneration) > 0) {
+                return true;
             }
-            return this->score > newHash.score;
+            // From this search, only a result at least as deep replaces it
+            if (depth != newHash.depth) {
+                return depth < newHash.depth;
+            }
+            return newHash.flag == TT_EXACT || flag != TT_EXACT;
         }
 
-        void looked() {
-            this->isAncient = false;
+        void looked(uint8_t currentGeneration) {
+            this->generation = currentGeneration;
         }
 };
 
-std::istream& operator>> (std::istream& is, HashEntry& hashEntry) {
-    is >> hashEntry.zobristHash;
-    is >> hashEntry.score;
-    is >> hashEntry.depth;
-    is >> hashEntry.flag;
-    is >> hashEntry.isAncient;
-    uint8_t origin, target;
-    is >> origin;
-    is >> target;
-    hashEntry.bestMove = {origin, target};
-    return is;
-}
-
-std::ostream& operator<< (std::ostream& os, const HashEntry& hashEntry) {
-    os << hashEntry.zobristHash;
-    os << hashEntry.score;
-    os << hashEntry.depth;
-    os << hashEntry.flag;
-    os << hashEntry.isAncient;
-    os << hashEntry.bestMove[0];
-    os << hashEntry.bestMove[1];
-    return os;
-}
+static_assert(sizeof(HashEntry) <= 16, "HashEntry must stay packed");
+
+// Snapshot file: header followed by the raw non-empty entries
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint64_t entryCount;
+};
+const char snapshotMagic[8] = {'C', 'H', 'S', 'T', 'T', 'S', 'N', 'P'};
+// Bump whenever HashEntry changes
+const uint32_t snapshotVersion = 1;
+
+// Entries sharing a cache line, a probe touches a single line
+struct alignas(CACHE_LINE_SIZE) HashBucket {
+    std::array<HashEntry, CACHE_LINE_SIZE / sizeof(HashEntry)> entries;
+};
+
+class BucketLock {
+    // Spins, the critical sections are a handful of loads and stores
+    private:
+        std::atomic_flag &flag;
+    public:
+        BucketLock(std::atomic_flag &flag): flag(flag) {
+            while (flag.test_and_set(std::memory_order_acquire)) {
+
+            }
+        }
+
+        ~BucketLock() {
+            flag.clear(std::memory_order_release);
+        }
+};
 
 class TranspositionTable {
     private:
-        std::vector<HashEntry> cache;
+        std::vector<HashBucket> buckets;
+        // Buckets are only read or written under their stripe's lock, so search threads can share the table
+        std::unique_ptr<std::atomic_flag[]> locks = std::make_unique<std::atomic_flag[]>(TT_LOCK_COUNT);
+        unsigned long long bucketMask = 0;
+        // Entries of older generations can be replaced, wraps around. Bumped once per search by the main bot
+        std::atomic<uint8_t> generation = 1;
         string gameId;
         bool isLoaded = false;
+
+        HashBucket& getBucket(unsigned long long zobristVal) {
+            return buckets[zobristVal & bucketMask];
+        }
+
+        std::atomic_flag& getLock(unsigned long long zobristVal) {
+            return locks[zobristVal & bucketMask & (TT_LOCK_COUNT - 1)];
+        }
     public:
         static const string cacheRoot;
-        TranspositionTable(string gameId) {
-            cache = std::vector<HashEntry>(CACHE_SIZE);
+        TranspositionTable(string gameId, unsigned int sizeMB = DEFAULT_HASH_MB) {
             this->gameId = gameId;
+            resize(sizeMB);
             loadCache();
         }
 
         TranspositionTable() {
             // Empty tables used when TT is disabled
-            cache = std::vector<HashEntry>();
-            cache.shrink_to_fit();
+            buckets = std::vector<HashBucket>();
+            buckets.shrink_to_fit();
             isLoaded = false;
         }
 
+        void resize(unsigned int sizeMB) {
+            // Largest power of 2 number of buckets that fits, so the index is a mask
+            unsigned long long bucketCount = 1;
+            while (bucketCount * 2 * sizeof(HashBucket) <= (unsigned long long) sizeMB * 1024 * 1024) {
+                bucketCount *= 2;
+            }
+            buckets = std::vector<HashBucket>(bucketCount);
+            bucketMask = bucketCount - 1;
+        }
+
         void loadCache() {
+            // Maps the snapshot and inserts its entries, so it loads into a table of any size
+            auto start = std::chrono::steady_clock::now();
             string cachePath = cacheRoot + gameId;
-            std::ifstream cacheFile(cachePath);
-            if (cacheFile.is_open()) {
+            clear();
+            isLoaded = true;
+            int fd = open(cachePath.c_str(), O_RDONLY);
+            if (fd < 0) {
+                logging::d("TT", "Cache file not found, creating new cache");
+                return;
+            }
+            struct stat fileStat;
+            if (fstat(fd, &fileStat) != 0 || (size_t) fileStat.st_size < sizeof(SnapshotHeader)) {
+                close(fd);
+                return;
+            }
+            size_t fileSize = fileStat.st_size;
+            char *data = (char *) mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (data == MAP_FAILED) {
+                return;
+            }
+            SnapshotHeader header;
+            std::memcpy(&header, data, sizeof(header));
+            if (std::memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0
+                || header.version != snapshotVersion
+                || header.entrySize != sizeof(HashEntry)
+                || fileSize != sizeof(SnapshotHeader) + header.entryCount * sizeof(HashEntry)) {
+
+                logging::w("TT", "Cache file is invalid or outdated, creating new cache");
+            } else {
                 logging::d("TT", "Cache file found, reading...");
-                for (int i=0; i < CACHE_SIZE; i++) {
-                    cacheFile >> cache[i];
+                HashEntry entry;
+                for (uint64_t i=0; i < header.entryCount; i++) {
+                    std::memcpy(&entry, data + sizeof(SnapshotHeader) + i * sizeof(HashEntry), sizeof(HashEntry));
+                    set(entry);
                 }
-                cacheFile.close();
-            } else {
-                logging::d("TT", "Cache file not found, creating new cache");
-                cache.assign(CACHE_SIZE, HashEntry());
             }
-            isLoaded = true;
+            munmap(data, fileSize);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            stats::ttLoadTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
         }
 
         void clear() {
-            cache.assign(CACHE_SIZE, HashEntry());
+            std::fill(buckets.begin(), buckets.end(), HashBucket());
+        }
+
+        void prefetch(unsigned long long zobristVal) {
+            // Starts loading the bucket's cache line, probe it a little later
+            if (isLoaded) {
+                __builtin_prefetch(&getBucket(zobristVal));
+            }
         }
 
-        std::shared_ptr<HashEntry> get(const unsigned long long &zobristVal) {
+        bool probe(unsigned long long zobristVal, HashEntry &entry) {
+            // Copies the entry into caller storage, returns false on a miss
             if (!isLoaded) {
-                return std::shared_ptr<HashEntry>(nullptr);
+                return false;
             }
-            std::shared_ptr<HashEntry> entry = std::make_shared<HashEntry>(cache[zobristVal % CACHE_SIZE]);
-            if (entry->zobristHash == zobristVal) {
-                entry->looked();
-                return entry;
+            BucketLock lock(getLock(zobristVal));
+            for (HashEntry &current: getBucket(zobristVal).entries) {
+                if (current.zobristHash == zobristVal && !current.isEmpty()) {
+                    current.looked(generation.load(std::memory_order_relaxed));
+                    entry = current;
+                    return true;
+                }
             }
             stats::missTT();
-            return nullptr;
+            return false;
         }
 
         void set(const HashEntry &entry) {
             if (!isLoaded) {
                 return;
             }
-            if (cache[entry.zobristHash % CACHE_SIZE].replaceHash(entry)) {
+            BucketLock lock(getLock(entry.zobristHash));
+            uint8_t generation = this->generation.load(std::memory_order_relaxed);
+            // Same position first, otherwise the entry with the lowest replacement value if it can be replaced
+            HashEntry *replaced = nullptr;
+            for (HashEntry &current: getBucket(entry.zobristHash).entries) {
+                if (current.zobristHash == entry.zobristHash && !current.isEmpty()) {
+                    replaced = current.replaceHash(entry, generation) || entry.depth >= current.depth ? &current : nullptr;
+                    break;
+                }
+                if (replaced == nullptr || current.getReplacementValue(generation) < replaced->getReplacementValue(generation)) {
+                    replaced = &current;
+                }
+            }
+            if (replaced != nullptr && replaced->zobristHash != entry.zobristHash && !replaced->replaceHash(entry, generation)) {
+                replaced = nullptr;
+            }
+            if (replaced != nullptr) {
                 stats::insertTT();
-                cache[entry.zobristHash % CACHE_SIZE] = entry;
+                *replaced = entry;
+                replaced->generation = generation;
             } else {
                 stats::collisionTT();
             }
         }
 
         void dumpCache() {
+            // Only used entries are stored. Written to a temporary file first so a reader never sees a partial file
             if (!isLoaded) {
                 return;
             }
-            string cachePath = cacheRoot + gameId;
-            std::ofstream cacheFile(cachePath);
-            if (cacheFile.is_open()) {
-                for (int i=0; i < CACHE_SIZE; i++) {
-                    cacheFile << cache[i];
+            auto start = std::chrono::steady_clock::now();
+            std::vector<HashEntry> entries;
+            for (HashBucket &bucket: buckets) {
+                for (HashEntry &entry: bucket.entries) {
+                    if (!entry.isEmpty()) {
+                        entries.push_back(entry);
+                    }
                 }
-                cacheFile.close();
             }
+            SnapshotHeader header;
+            std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+            header.version = snapshotVersion;
+            header.entrySize = sizeof(HashEntry);
+            header.entryCount = entries.size();
+
+            string cachePath = cacheRoot + gameId;
+            string tempPath = cachePath + ".tmp";
+            std::ofstream cacheFile(tempPath, std::ios::binary | std::ios::trunc);
+            cacheFile.write((const char *) &header, sizeof(header));
+            cacheFile.write((const char *) entries.data(), entries.size() * sizeof(HashEntry));
+            cacheFile.close();
+            if (!cacheFile || std::rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+                logging::e("TT", "Could not write cache file " + cachePath);
+                std::remove(tempPath.c_str());
+                return;
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            stats::ttStoreTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
         }
 
         bool isCacheLoaded() {
             return isLoaded;
         }
 
-        void resetAge() {
-            if (!isLoaded) {
-                return;
-            }
-            for (auto i = cache.begin(); i != cache.end(); i++) {
-                i->isAncient = true;
-            }
+        void nextGeneration() {
+            // Ages every entry at once
+            generation++;
         }
 };
 
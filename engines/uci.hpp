@@ -11,6 +11,8 @@
 #include "transpositionTables.hpp"
 #include "statsutil.hpp"
 #include "chessBot.hpp"
+#include "perft.hpp"
+#include "timeManagement.hpp"
 #include "utils.hpp"
 
 namespace uci {
@@ -26,13 +28,22 @@ namespace uci {
             << std::endl;
     }
 
+    void formatOption(std::string name, const char *defaultVal) {
+        // Type: String
+        std::cout << "option name " << name << " type string default " << defaultVal << std::endl;
+    }
+
     void displayOptions() {
         formatOption("Depth", 5, 1, 7);
+        formatOption("Hash", DEFAULT_HASH_MB, MIN_HASH_MB, MAX_HASH_MB);
+        formatOption("Threads", DEFAULT_THREADS, MIN_THREADS, MAX_THREADS);
         formatOption("EnableAlphaBetaPruning", true);
         formatOption("EnableTranspositionTable", true);
         formatOption("EnableIterativeDeepening", true);
         formatOption("EnableNullMovePruning", false);
         formatOption("EnableQuiescenceSearch", false);
+        formatOption("OwnBook", true);
+        formatOption("BookFile", book::defaultBookFile.c_str());
         formatOption("AttackMultiplier", 20, 1, 100);
         formatOption("DefenceMultiplier", 16, 1, 100);
         formatOption("SpaceMultiplier", 8, 1, 100);
@@ -46,13 +57,48 @@ namespace uci {
         return false;
     }
 
+    timeManagement::TimeBudget parseTimeBudget(const vector<string> &inputArgs, playerType player) {
+        // go [movetime x] [wtime x] [btime x] [winc x] [binc x] [movestogo x], anything else searches without a limit
+        long timeLeft = -1, increment = 0, moveTime = -1;
+        int movesToGo = 0;
+        for (size_t i=1; i + 1 < inputArgs.size(); i++) {
+            const string &name = inputArgs[i];
+            if (name == "movetime") {
+                moveTime = std::stol(inputArgs[i + 1]);
+            } else if (name == (player == WHITE ? "wtime" : "btime")) {
+                timeLeft = std::stol(inputArgs[i + 1]);
+            } else if (name == (player == WHITE ? "winc" : "binc")) {
+                increment = std::stol(inputArgs[i + 1]);
+            } else if (name == "movestogo") {
+                movesToGo = std::stoi(inputArgs[i + 1]);
+            }
+        }
+        if (moveTime >= 0) {
+            return timeManagement::fromMoveTime(moveTime);
+        }
+        if (timeLeft >= 0) {
+            return timeManagement::fromClock(timeLeft, increment, movesToGo);
+        }
+        return timeManagement::unlimited;
+    }
+
     void run() {
         const string startPos = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 1 1";
         string input;
         preCalculation::preCalcType preCalculatedData = preCalculation::load();
         ChessBot bot(randomUtils::getHashFileName(), preCalculatedData);
-        bool isCalculatingMove = false;
+        // At most one search at a time. Commands that touch the bot or the board stop it and wait for its bestmove first
+        std::thread searchThread;
+        auto stopSearch = [&]() {
+            if (searchThread.joinable()) {
+                bot.interrupt();
+                searchThread.join();
+            }
+        };
         Board board(startPos, preCalculatedData->PRN);
+        // Match the advertised defaults, Threads has no effect without the TT
+        bot.setEnableTT(true);
+        bot.setEnableBook(true);
         do {
             std::getline(std::cin, input);
             vector<string> inputArgs = stringUtils::split(input), originalArgs(inputArgs.size());
@@ -68,8 +114,10 @@ namespace uci {
             } else if (input == "isready") {
                 std::cout << "readyok" << std::endl;
             } else if (input == "quit") {
+                stopSearch();
                 exit(0);
             } else if (inputArgs[0] == "setoption") {
+                stopSearch();
                 if ((inputArgs.size() >= 3
                     && inputArgs.size() != 5)
                     || inputArgs[1] != "name"
@@ -79,13 +127,27 @@ namespace uci {
                     continue;
                 }
                 if (inputArgs[2] == "depth") {
-                    uint8_t depth = std::stoi(inputArgs[3]);
+                    int depth = std::stoi(inputArgs[4]);
                     if (depth > MAX_ALLOWED_DEPTH) {
                         std::cout << "Depth cannot be greater than " << MAX_ALLOWED_DEPTH << std::endl;
                     } else if (depth < MIN_ALLOWED_DEPTH) {
                         std::cout << "Depth cannot be lesser than " << MIN_ALLOWED_DEPTH << std::endl;
                     } else {
-                        bot.setMaxDepth(std::stoi(inputArgs[3]));
+                        bot.setMaxDepth(depth);
+                    }
+                } else if (inputArgs[2] == "hash") {
+                    int sizeMB = std::stoi(inputArgs[4]);
+                    if (sizeMB > MAX_HASH_MB || sizeMB < MIN_HASH_MB) {
+                        std::cout << "Hash must be between " << MIN_HASH_MB << " and " << MAX_HASH_MB << " MB" << std::endl;
+                    } else {
+                        bot.setHashSize(sizeMB);
+                    }
+                } else if (inputArgs[2] == "threads") {
+                    int threads = std::stoi(inputArgs[4]);
+                    if (threads > MAX_THREADS || threads < MIN_THREADS) {
+                        std::cout << "Threads must be between " << MIN_THREADS << " and " << MAX_THREADS << std::endl;
+                    } else {
+                        bot.setThreads(threads);
                     }
                 } else if (inputArgs[2] == "enabletranspositiontable") {
                     if (validateCheckType(inputArgs[4], "enabletranspositiontable")) {
@@ -107,6 +169,12 @@ namespace uci {
                     if (validateCheckType(inputArgs[4], "enablequiescencesearch")) {
                         bot.setEnableQuiescenceSearch(inputArgs[4] == "true");
                     }
+                } else if (inputArgs[2] == "ownbook") {
+                    if (validateCheckType(inputArgs[4], "ownbook")) {
+                        bot.setEnableBook(inputArgs[4] == "true");
+                    }
+                } else if (inputArgs[2] == "bookfile") {
+                    bot.setBookPath(originalArgs[4]);
                 } else if (inputArgs[2] == "attackmultiplier") {
                     bot.setAttackMultiplier(std::stof(inputArgs[4]));
                 } else if (inputArgs[2] == "defencemultiplier") {
@@ -117,8 +185,10 @@ namespace uci {
                     std::cout << "Invalid setoption command" << std::endl;
                 }
             } else if (input == "ucinewgame") {
+                stopSearch();
                 bot.newGame();
             } else if (inputArgs[0] == "position") {
+                stopSearch();
                 uint8_t movesStartIndex = 1;
                 if (inputArgs[1] == "startpos") {
                     movesStartIndex++;
@@ -139,35 +209,33 @@ namespace uci {
                     }
                 }
             } else if (inputArgs[0] == "go") {
+                stopSearch();
                 logging::d("UCI", "Player: " + std::to_string(board.player));
-                if (inputArgs.size() == 1 || inputArgs[1] == "infinite") {
-                    // Infinite search
-                    isCalculatingMove = true;
-                    std::thread blockingThread([](ChessBot &bot, Board &board) {
-                        std::thread aiThread(&ChessBot::getNextMove, &bot, std::ref(board));
-                        aiThread.join();
-                        if (!bot.getIsInterrupted()) {
-                            // Calculation is done
-                            std::cout << "bestmove " << bot.getLastCalculatedMoveAsNotation() << std::endl;
-                        }
+                moveType bookMove = NULL_MOVE;
+                if (inputArgs.size() > 2 && inputArgs[1] == "perft") {
+                    // Leaf node count, blocks until done
+                    perft::printResult(perft::run(board, preCalculatedData, std::stoi(inputArgs[2])));
+                } else if ((bookMove = bot.getBookMove(board)) != NULL_MOVE) {
+                    // Known position, answered without searching
+                    std::cout << "bestmove " << moveUtils::toNotation(bookMove) << std::endl;
+                } else {
+                    // Searches until done, stopped or out of time, the search thread reports the move
+                    bot.setTimeBudget(parseTimeBudget(inputArgs, board.player));
+                    searchThread = std::thread([](ChessBot &bot, Board &board) {
+                        bot.getNextMove(board);
+                        std::cout << "bestmove " << bot.getLastCalculatedMoveAsNotation() << std::endl;
                     }, std::ref(bot), std::ref(board));
-                    blockingThread.detach();
-                } else if (inputArgs[1] == "movetime") {
-                    // Search for a specific amount of time(ms)
-                    isCalculatingMove = true;
-                    std::thread timerThread([](Board &boardInstance, ChessBot &bot, unsigned long timeMs) {
-                        std::thread internalThread(&ChessBot::getNextMove, &bot, std::ref(boardInstance));
-                        std::this_thread::sleep_for(std::chrono::milliseconds(timeMs));
-                        bot.interrupt(true);
-                        internalThread.join();
-                    }, std::ref(board), std::ref(bot), std::stoi(inputArgs[2]));
-                    timerThread.detach();
                 }
-            } else if (isCalculatingMove && input == "stop") {
-                isCalculatingMove = false;
-                bot.interrupt(true);
+            } else if (inputArgs[0] == "perft" && inputArgs.size() > 2 && inputArgs[1] == "divide") {
+                stopSearch();
+                // Leaf node count for every root move
+                perft::printDivide(board, preCalculatedData, std::stoi(inputArgs[2]));
+            } else if (input == "stop") {
+                stopSearch();
             } else if (input == "d") {
+                stopSearch();
                 debug::printBoard(board, true);
+                std::cout << "Fen: " << board.getFen() << std::endl;
             }
         } while (true);
     }
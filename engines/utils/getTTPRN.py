@@ -6,7 +6,7 @@ from secrets import randbits
 8 numbers to indicate the castling rights(4 values, each can be 1 or 0, therefore 2*4)
 8 numbers to indicate the file of a valid En passant square, if any
 """
-count = 64*10 + 56*2 + 1 + 4 + 8
+count = 64*10 + 56*2 + 1 + 8 + 8
 
 nums = []
 